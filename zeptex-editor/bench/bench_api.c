@@ -0,0 +1,136 @@
+/* bench_api.c - cost of each libzeptex call
+   Builds a buffer of synthetic lines through the API, saves and loads
+   it (plain and gzip), then times inserts and deletes at the front,
+   middle and end, random zx_line() lookups and a full iteration.
+
+   make bench_api     (or: gcc -O2 -pthread -I. -o bench_api \
+       bench/bench_api.c zeptex.c edits.c stream.c stream_gz.c -lz)
+   ./bench_api [lines] [ops]
+*/
+#include "zeptex.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, uint64_t *ns, size_t ops) {
+    qsort(ns, ops, sizeof(uint64_t), cmp_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < ops; ++i) total += ns[i];
+    printf("%-22s %10zu %12.0f %12llu %12llu\n", name, ops, (double)total / ops,
+           (unsigned long long)ns[ops / 2], (unsigned long long)ns[ops * 99 / 100]);
+}
+
+// Time one call that is run once, such as a load or a save
+static void report_once(const char *name, uint64_t ns, size_t lines) {
+    printf("%-22s %10zu %12.0f %12s %12s   (%.1f ns/line)\n", name, (size_t)1,
+           (double)ns, "-", "-", (double)ns / (lines ? lines : 1));
+}
+
+static const char *const body[] = {
+    "2024-05-01 12:00:00 INFO  request served in 12 ms",
+    "static int parse_header(const char *buf, size_t len) {",
+    "    return -1;",
+    "",
+    "key = value # a config line",
+};
+#define BODY_COUNT (sizeof(body) / sizeof(body[0]))
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+    uint64_t *ns = malloc(ops * sizeof(uint64_t));
+    zx_buffer *b = zx_buffer_new();
+    if (!ns || !b || !n || !ops) return 1;
+
+    char plain[64], gz[64];
+    snprintf(plain, sizeof(plain), "/tmp/bench_api_%d.txt", (int)getpid());
+    snprintf(gz, sizeof(gz), "/tmp/bench_api_%d.txt.gz", (int)getpid());
+
+    printf("%-22s %10s %12s %12s %12s\n", "call", "ops", "mean ns", "p50 ns", "p99 ns");
+
+    for (size_t i = 0; i < ops; ++i) {
+        uint64_t start = now_ns();
+        zx_buffer *t = zx_buffer_new();
+        ns[i] = now_ns() - start;
+        zx_buffer_free(t);
+    }
+    report("zx_buffer_new", ns, ops);
+
+    uint64_t t0 = now_ns();
+    for (size_t i = 0; i < n; ++i) {
+        const char *text = body[i % BODY_COUNT];
+        zx_insert(b, i, text, strlen(text));
+    }
+    report_once("zx_insert (append xN)", now_ns() - t0, n);
+
+    t0 = now_ns();
+    if (zx_save(b, plain) < 0) perror(plain);
+    report_once("zx_save", now_ns() - t0, n);
+    t0 = now_ns();
+    if (zx_save(b, gz) < 0) perror(gz);
+    report_once("zx_save .gz", now_ns() - t0, n);
+    t0 = now_ns();
+    if (zx_load(b, plain) < 0) perror(plain);
+    report_once("zx_load", now_ns() - t0, n);
+    t0 = now_ns();
+    if (zx_load(b, gz) < 0) perror(gz);
+    report_once("zx_load .gz", now_ns() - t0, n);
+    unlink(plain);
+    unlink(gz);
+
+    const char *where[] = { "front", "middle", "end" };
+    char name[32];
+    for (int w = 0; w < 3; ++w) {
+        for (int del = 0; del < 2; ++del) {
+            for (size_t i = 0; i < ops; ++i) {
+                size_t count = zx_line_count(b);
+                size_t at = w == 0 ? 0 : w == 1 ? count / 2 : count - del;
+                uint64_t start = now_ns();
+                if (del) zx_delete(b, at);
+                else zx_insert(b, at, body[0], strlen(body[0]));
+                ns[i] = now_ns() - start;
+            }
+            snprintf(name, sizeof(name), "%s %s", del ? "zx_delete" : "zx_insert", where[w]);
+            report(name, ns, ops);
+        }
+    }
+
+    srand(42);
+    size_t total = 0, len;
+    for (size_t i = 0; i < ops; ++i) {
+        size_t at = (size_t)rand() % zx_line_count(b);
+        uint64_t start = now_ns();
+        zx_line(b, at, &len);
+        ns[i] = now_ns() - start;
+        total += len;
+    }
+    report("zx_line random", ns, ops);
+
+    zx_iter it;
+    t0 = now_ns();
+    zx_iter_init(&it, b, 0);
+    while (zx_iter_next(&it, &len)) total += len;
+    report_once("zx_iter_next (all)", now_ns() - t0, zx_line_count(b));
+
+    t0 = now_ns();
+    zx_buffer_free(b);
+    report_once("zx_buffer_free", now_ns() - t0, n);
+
+    free(ns);
+    return total == 0;  // keeps the reads from being optimised away
+}
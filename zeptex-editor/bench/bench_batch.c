@@ -0,0 +1,98 @@
+/* bench_batch.c - applying a large patch: zx_apply against one call per line
+   Builds a buffer, then a patch of evenly spread hunks that each replace
+   one line with two, and applies it with a single zx_apply().  For the
+   baseline hunks go through zx_insert/zx_delete, back to front so the
+   indices stay valid; each of those calls shifts the tail, so only a
+   sample spread over the whole buffer is timed and the total for all
+   hunks is extrapolated.
+
+   make bench_batch   (or: gcc -O2 -pthread -I. -o bench_batch \
+       bench/bench_batch.c zeptex.c edits.c stream.c stream_gz.c -lz)
+   ./bench_batch [lines] [hunks]
+*/
+#include "zeptex.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BASELINE_HUNKS 2000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static zx_buffer *make_buffer(size_t n) {
+    static const char line[] = "key = value # a config line";
+    zx_buffer *b = zx_buffer_new();
+    for (size_t i = 0; b && i < n; ++i)
+        if (zx_insert(b, i, line, sizeof(line) - 1) < 0) return NULL;
+    return b;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t hunks = argc > 2 ? strtoul(argv[2], NULL, 10) : 50000;
+    if (!hunks || hunks > n) {
+        fprintf(stderr, "need 0 < hunks <= lines\n");
+        return 1;
+    }
+
+    static const char new1[] = "key = changed";
+    static const char new2[] = "added = 1";
+    size_t step = n / hunks;
+    zx_edit *edits = malloc(3 * hunks * sizeof(zx_edit));
+    zx_buffer *b = make_buffer(n);
+    if (!edits || !b) return 1;
+    for (size_t h = 0; h < hunks; ++h) {
+        size_t at = h * step;
+        edits[3 * h]     = (zx_edit){ ZX_DELETE, at, NULL, 0 };
+        edits[3 * h + 1] = (zx_edit){ ZX_INSERT, at, new1, sizeof(new1) - 1 };
+        edits[3 * h + 2] = (zx_edit){ ZX_INSERT, at, new2, sizeof(new2) - 1 };
+    }
+
+    printf("%zu lines, %zu hunks (%zu edits)\n\n", n, hunks, 3 * hunks);
+    printf("%-28s %14s %14s\n", "method", "total ms", "ns/edit");
+
+    uint64_t t0 = now_ns();
+    if (zx_apply(b, edits, 3 * hunks) < 0) {
+        perror("zx_apply");
+        return 1;
+    }
+    uint64_t batch = now_ns() - t0;
+    printf("%-28s %14.3f %14.1f\n", "zx_apply", batch / 1e6, (double)batch / (3 * hunks));
+    size_t expect = n + hunks;
+    if (zx_line_count(b) != expect) {
+        fprintf(stderr, "zx_apply left %zu lines, expected %zu\n", zx_line_count(b), expect);
+        return 1;
+    }
+    zx_buffer_free(b);
+
+    // Baseline: every stride-th hunk, the last first so that earlier
+    // indices are unaffected
+    b = make_buffer(n);
+    if (!b) return 1;
+    size_t stride = hunks > BASELINE_HUNKS ? hunks / BASELINE_HUNKS : 1;
+    size_t timed = 0;
+    t0 = now_ns();
+    for (size_t h = hunks; h >= stride; timed++) {
+        h -= stride;
+        size_t at = h * step;
+        zx_delete(b, at);
+        zx_insert(b, at, new2, sizeof(new2) - 1);
+        zx_insert(b, at, new1, sizeof(new1) - 1);
+    }
+    uint64_t single = now_ns() - t0;
+    double per_hunk = (double)single / timed;
+    printf("%-28s %14.3f %14.1f%s\n", "zx_insert/zx_delete", per_hunk * hunks / 1e6,
+           per_hunk / 3, timed < hunks ? "   (extrapolated)" : "");
+    printf("\nspeed-up: %.1fx\n", per_hunk * hunks / (double)batch);
+
+    zx_buffer_free(b);
+    free(edits);
+    return 0;
+}
@@ -0,0 +1,200 @@
+/* bench_buffer.c - the editor's buffer primitives, for tracking regressions
+   For each file size: load_file and save_file of a synthetic file, then
+   insert_line and delete_line at the front, middle, end and at random
+   lines, and draw_buffer with the view at the same places, rendered
+   into a memory stream instead of the terminal.  Prints one CSV row per
+   measurement so runs can be compared release over release:
+
+       op,size,lines,pattern,ops,mean_ns,p50_ns,p99_ns,bytes
+
+   bytes is the file size for load and save, the output of one frame
+   for draw_buffer and empty otherwise.  Sizes take a K, M or G suffix.
+
+   make bench_buffer  (or: gcc -O2 -pthread -DMAX_LINES=40000000 -I. -o bench_buffer \
+       bench/bench_buffer.c buffer.c diff.c editor.c edits.c follow.c highlight.c input.c \
+       pager.c reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz)
+   ./bench_buffer [size ...]       (default: 1K 1M 1G)
+*/
+#include "editor.h"
+#include "buffer.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define EDIT_OPS     1000   // per pattern, up to a million lines
+#define EDIT_OPS_BIG 100    // beyond that, where each edit shifts the tail
+#define IO_BYTES     (64u << 20)    // repeat load/save until this much is moved
+#define SCREEN_ROWS  50
+#define SCREEN_COLS  120
+
+static size_t file_lines;   // lines in the file under test
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *op, size_t size, const char *pattern,
+                   uint64_t *ns, size_t ops, long bytes) {
+    qsort(ns, ops, sizeof(uint64_t), cmp_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < ops; ++i) total += ns[i];
+    printf("%s,%zu,%zu,%s,%zu,%.0f,%llu,%llu,", op, size, file_lines, pattern, ops,
+           (double)total / ops, (unsigned long long)ns[ops / 2],
+           (unsigned long long)ns[ops * 99 / 100]);
+    if (bytes >= 0) printf("%ld", bytes);
+    printf("\n");
+    fflush(stdout);
+}
+
+static const char *const body[] = {
+    "2024-05-01 12:00:00 INFO  request served in 12 ms",
+    "static int parse_header(const char *buf, size_t len) {",
+    "    return -1;",
+    "",
+    "key = value # a config line",
+};
+#define BODY_COUNT (sizeof(body) / sizeof(body[0]))
+
+static int write_file(const char *path, size_t size) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    for (size_t written = 0, i = 0; written < size; ++i) {
+        const char *l = body[i % BODY_COUNT];
+        size_t len = strlen(l);
+        if (written + len + 1 > size) len = size - written - 1;
+        fwrite(l, 1, len, f);
+        fputc('\n', f);
+        written += len + 1;
+    }
+    return fclose(f);
+}
+
+static void clear_buffer(void) {
+    while (line_count) free(lines[--line_count]);
+}
+
+static size_t parse_size(const char *s) {
+    char *end;
+    size_t n = strtoul(s, &end, 10);
+    switch (*end) {
+    case 'G': case 'g': n <<= 10; /* fall through */
+    case 'M': case 'm': n <<= 10; /* fall through */
+    case 'K': case 'k': n <<= 10;
+    }
+    return n;
+}
+
+// 1-based line for an edit or a view: front, middle, end or random
+static size_t place(int pattern, size_t count) {
+    switch (pattern) {
+    case 0: return 1;
+    case 1: return count / 2 + 1;
+    case 2: return count;
+    default: return 1 + (size_t)rand() % (count ? count : 1);
+    }
+}
+
+static const char *const patterns[] = { "front", "middle", "end", "random" };
+
+static int run(size_t size, const char *path, uint64_t *ns) {
+    if (write_file(path, size) < 0) return -1;
+
+    size_t reps = size < IO_BYTES ? IO_BYTES / size : 1;
+    if (reps > 1000) reps = 1000;
+    for (size_t r = 0; r < reps; ++r) {
+        clear_buffer();
+        uint64_t t0 = now_ns();
+        load_file(path);
+        ns[r] = now_ns() - t0;
+    }
+    if (line_count == MAX_LINES) {
+        fprintf(stderr, "%zu bytes is more than MAX_LINES lines; rebuild with a larger one\n", size);
+        return -1;
+    }
+    file_lines = line_count;
+    report("load_file", size, "-", ns, reps, (long)size);
+    for (size_t r = 0; r < reps; ++r) {
+        uint64_t t0 = now_ns();
+        save_file(path);
+        ns[r] = now_ns() - t0;
+    }
+    report("save_file", size, "-", ns, reps, (long)size);
+    unlink(path);
+
+    size_t ops = line_count > 1000000 ? EDIT_OPS_BIG : EDIT_OPS;
+    for (int p = 0; p < 4; ++p) {
+        srand(42);
+        for (size_t i = 0; i < ops; ++i) {
+            size_t at = p == 2 ? line_count + 1 : place(p, line_count);
+            uint64_t t0 = now_ns();
+            insert_line(at, body[i % BODY_COUNT]);
+            ns[i] = now_ns() - t0;
+        }
+        report("insert_line", size, patterns[p], ns, ops, -1);
+        srand(42);
+        for (size_t i = 0; i < ops; ++i) {
+            size_t at = place(p, line_count);
+            uint64_t t0 = now_ns();
+            delete_line(at);
+            ns[i] = now_ns() - t0;
+        }
+        report("delete_line", size, patterns[p], ns, ops, -1);
+    }
+
+    // Frames go to memory; glibc lets stdout be reassigned
+    char *frame = NULL;
+    size_t frame_len = 0;
+    FILE *sink = open_memstream(&frame, &frame_len), *term = stdout;
+    if (!sink) return -1;
+    set_window_size(SCREEN_ROWS, SCREEN_COLS);
+    for (int p = 0; p < 4; ++p) {
+        long bytes = 0;
+        srand(42);
+        for (size_t i = 0; i < ops; ++i) {
+            scroll_offset = place(p, line_count) - 1;
+            stdout = sink;
+            rewind(sink);
+            uint64_t t0 = now_ns();
+            draw_buffer();
+            ns[i] = now_ns() - t0;
+            bytes = ftell(sink);
+            stdout = term;
+        }
+        report("draw_buffer", size, patterns[p], ns, ops, bytes);
+    }
+    fclose(sink);
+    free(frame);
+    clear_buffer();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *defaults[] = { "1K", "1M", "1G" };
+    const char **sizes = argc > 1 ? (const char **)argv + 1 : defaults;
+    int count = argc > 1 ? argc - 1 : 3;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_buffer_%d.txt", (int)getpid());
+    uint64_t *ns = malloc(1000 * sizeof(uint64_t));
+    if (!ns || buffer_init(NULL) < 0) return 1;
+
+    printf("op,size,lines,pattern,ops,mean_ns,p50_ns,p99_ns,bytes\n");
+    for (int i = 0; i < count; ++i) {
+        size_t size = parse_size(sizes[i]);
+        if (!size || run(size, path, ns) < 0) {
+            fprintf(stderr, "bench_buffer: %s: failed\n", sizes[i]);
+            unlink(path);
+            return 1;
+        }
+    }
+    buffer_close_all();
+    free(ns);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* bench_diff.c - the diff command on a large file
+   Writes a file of synthetic source lines, then for each edit pattern
+   loads it, changes the buffer through apply_edits and times
+   diff_open(), which reads the file back, hashes both sides and diffs
+   them, and diff_hashes() alone on the same hashes.  Patterns range from a few scattered hunks to a tenth of the
+   lines changed, and the two halves of the file swapped.
+
+   make bench_diff    (or: gcc -O2 -pthread -DMAX_LINES=1200000 -I. -o bench_diff \
+       bench/bench_diff.c buffer.c diff.c editor.c edits.c follow.c highlight.c input.c \
+       pager.c reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz)
+   ./bench_diff [lines]
+*/
+#include "editor.h"
+#include "buffer.h"
+#include "diff.h"
+
+#include <stdint.h>
+#include <time.h>
+
+static uint64_t *hash_buffer(void) {
+    uint64_t *h = malloc((line_count + 1) * sizeof(uint64_t));
+    for (size_t i = 0; h && i < line_count; ++i) h[i] = line_hash(lines[i], strlen(lines[i]));
+    return h;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Mostly distinct lines with the repeats real code has
+static int write_file(const char *path, size_t n) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    for (size_t i = 0; i < n; ++i) {
+        switch (i % 8) {
+        case 0: fputs("\n", f); break;
+        case 1: fputs("    }\n", f); break;
+        default: fprintf(f, "    value_%zu = compute(%zu, %zu);\n", i, i % 97, i % 13); break;
+        }
+    }
+    return fclose(f);
+}
+
+// hunks evenly spread changes: each replaces one line with two
+static int change(size_t hunks) {
+    static const char new1[] = "    changed = 1;";
+    static const char new2[] = "    added = compute(0, 0);";
+    zx_edit *edits = malloc(3 * hunks * sizeof(zx_edit));
+    if (!edits) return -1;
+    size_t step = line_count / hunks;
+    for (size_t h = 0; h < hunks; ++h) {
+        size_t at = h * step + step / 2;
+        edits[3 * h]     = (zx_edit){ ZX_DELETE, at, NULL, 0 };
+        edits[3 * h + 1] = (zx_edit){ ZX_INSERT, at, new1, sizeof(new1) - 1 };
+        edits[3 * h + 2] = (zx_edit){ ZX_INSERT, at, new2, sizeof(new2) - 1 };
+    }
+    int r = apply_edits(edits, 3 * hunks);
+    free(edits);
+    return r;
+}
+
+// The second half first
+static int swap_halves(void) {
+    size_t half = line_count / 2;
+    zx_edit *edits = malloc((line_count + 1) * sizeof(zx_edit));
+    if (!edits) return -1;
+    size_t k = 0;
+    for (size_t i = half; i < line_count; ++i)
+        edits[k++] = (zx_edit){ ZX_INSERT, 0, lines[i], strlen(lines[i]) };
+    for (size_t i = half; i < line_count; ++i)
+        edits[k++] = (zx_edit){ ZX_DELETE, i, NULL, 0 };
+    int r = apply_edits(edits, k);
+    free(edits);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    if (n < 1000 || n + n / 10 > MAX_LINES) {
+        fprintf(stderr, "need 1000 lines or more; rebuild with -DMAX_LINES=%zu or more\n",
+                n + n / 10);
+        return 1;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_diff_%d.txt", (int)getpid());
+    if (write_file(path, n) < 0 || buffer_init(path) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    printf("%zu lines\n\n%-18s %10s %10s %16s %14s\n", n, "pattern", "added", "removed",
+           "diff_hashes ms", "diff_open ms");
+    const char *names[] = { "unchanged", "10 hunks", "1000 hunks", "10% of lines",
+                            "halves swapped" };
+    size_t hunks[] = { 0, 10, 1000, n / 10, 0 };
+    for (int p = 0; p < 5; ++p) {
+        while (line_count) free(lines[--line_count]);
+        load_file(path);
+        size_t old_count = line_count;
+        uint64_t *a = hash_buffer();
+        if ((hunks[p] && change(hunks[p]) < 0) || (p == 4 && swap_halves() < 0)) {
+            perror("apply_edits");
+            return 1;
+        }
+        uint64_t *b = hash_buffer();
+        char *del = malloc(old_count + 1), *ins = malloc(line_count + 1);
+        if (!a || !b || !del || !ins) return 1;
+
+        uint64_t t0 = now_ns();
+        if (diff_hashes(a, old_count, b, line_count, del, ins) < 0) return 1;
+        uint64_t core = now_ns() - t0;
+        t0 = now_ns();
+        diff_open();
+        uint64_t full = now_ns() - t0;
+        diff_close();
+
+        size_t added = 0, removed = 0;
+        for (size_t i = 0; i < old_count; ++i) removed += del[i];
+        for (size_t j = 0; j < line_count; ++j) added += ins[j];
+        printf("%-18s %10zu %10zu %16.1f %14.1f\n", names[p], added, removed,
+               core / 1e6, full / 1e6);
+        free(a);
+        free(b);
+        free(del);
+        free(ins);
+    }
+
+    unlink(path);
+    buffer_close_all();
+    return 0;
+}
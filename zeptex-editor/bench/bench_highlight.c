@@ -0,0 +1,110 @@
+/* bench_highlight.c - re-highlight cost per edit
+   Builds a large synthetic C buffer, highlights it once, then applies
+   edits through insert_line/delete_line and re-highlights the screen
+   around each edit the way draw_buffer does.  Reports lines lexed and
+   time per edit for each edit pattern.
+
+   gcc -O2 -pthread -DMAX_LINES=200000 -I. -o bench_highlight \
+       bench/bench_highlight.c buffer.c diff.c editor.c edits.c follow.c highlight.c input.c \
+       pager.c reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz
+   ./bench_highlight [lines] [edits]
+*/
+#include "editor.h"
+#include "highlight.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define SCREEN_ROWS 40
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void fill_buffer(size_t n) {
+    static const char *const body[] = {
+        "static int parse_header(const char *buf, size_t len) {",
+        "    for (size_t i = 0; i < len; ++i) {",
+        "        if (buf[i] == '\\n') return (int)i; // end of header",
+        "    }",
+        "    return -1;",
+        "}",
+        "/* Multi-line comment describing the next function,",
+        "   spanning a few lines like real code does. */",
+        "#define HEADER_MAX 4096",
+        "",
+    };
+    for (size_t i = 0; i < n; ++i)
+        insert_line(line_count + 1, body[i % (sizeof(body) / sizeof(body[0]))]);
+}
+
+// Re-highlight the screen that shows buffer line index
+static void render_around(size_t index) {
+    size_t top = index > SCREEN_ROWS / 2 ? index - SCREEN_ROWS / 2 : 0;
+    for (size_t i = top; i < top + SCREEN_ROWS && i < line_count; ++i)
+        hl_line_attrs(i);
+}
+
+static void report(const char *name, uint64_t *ns, size_t edits, size_t lexed) {
+    qsort(ns, edits, sizeof(uint64_t), cmp_u64);
+    uint64_t total = 0;
+    for (size_t i = 0; i < edits; ++i) total += ns[i];
+    printf("%-22s %8zu %12.1f %12.0f %12llu %12llu\n", name, edits,
+           (double)lexed / edits, (double)total / edits,
+           (unsigned long long)ns[edits / 2], (unsigned long long)ns[edits * 99 / 100]);
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    size_t edits = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000;
+    if (n + 2 * edits > MAX_LINES) {     // three patterns insert, one deletes
+        fprintf(stderr, "rebuild with -DMAX_LINES=%zu or more\n", n + 2 * edits);
+        return 1;
+    }
+
+    fill_buffer(n);
+    hl_set(&hl_c);
+
+    uint64_t t0 = now_ns();
+    size_t before = hl_lexed_lines;
+    hl_line_attrs(line_count - 1);
+    printf("full highlight: %zu lines in %.3f ms\n\n",
+           hl_lexed_lines - before, (now_ns() - t0) / 1e6);
+
+    uint64_t *ns = malloc(edits * sizeof(uint64_t));
+    if (!ns) return 1;
+    printf("%-22s %8s %12s %12s %12s %12s\n",
+           "pattern", "edits", "lines/edit", "mean ns", "p50 ns", "p99 ns");
+
+    const char *patterns[] = { "insert code", "delete line", "open comment", "close comment" };
+    srand(42);
+    for (int p = 0; p < 4; ++p) {
+        size_t lexed = 0;
+        for (size_t e = 0; e < edits; ++e) {
+            size_t at = 1 + (size_t)rand() % line_count;
+            uint64_t start = now_ns();
+            before = hl_lexed_lines;
+            switch (p) {
+            case 0: insert_line(at, "    total += compute(x, 42); /* note */"); break;
+            case 1: delete_line(at); break;
+            case 2: insert_line(at, "/* unterminated comment"); break;
+            case 3: insert_line(at, "*/ int closed = 1;"); break;
+            }
+            render_around(at - 1);
+            ns[e] = now_ns() - start;
+            lexed += hl_lexed_lines - before;
+        }
+        report(patterns[p], ns, edits, lexed);
+    }
+
+    free(ns);
+    for (size_t i = 0; i < line_count; ++i) free(lines[i]);
+    return 0;
+}
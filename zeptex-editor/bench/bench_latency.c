@@ -0,0 +1,303 @@
+/* bench_latency.c - keystroke to frame latency, end to end on a pty
+   Starts the editor on a pseudo-terminal with a generated file and
+   plays a script into it: typing a command a key at a time, the arrows,
+   a paste (one write of many bytes) and the i, a and d commands.  After each key
+   or paste it reads until the frame it caused is complete, that is the
+   screen has been redrawn or updated and the output ends with the prompt and the
+   command typed so far, and records the time taken, the frames drawn
+   and the bytes written.  Reports p50/p99 latency and bytes per frame
+   for each kind of input.
+
+   The bench keeps its own copy of the buffer.  An edit must redraw the
+   whole screen, and every numbered row on it must match the copy, so
+   an edit the editor dropped fails the run instead of being timed.  The
+   file and the lines the rounds add must fit in MAX_LINES.
+
+   make bench_latency (or: gcc -O2 -I. -o bench_latency bench/bench_latency.c -lutil)
+   ./bench_latency [editor] [lines] [rounds]
+   (default: ./editor, as many lines as leave room for the rounds, 50)
+*/
+#define _GNU_SOURCE     // memmem
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "editor.h"     // MAX_LINES
+
+#define ROWS 50
+#define COLS 120
+#define FRAME_TIMEOUT_MS 2000
+#define CLEAR "\033[H\033[J"    // draw_buffer starts a full frame with it
+#define PARTIAL "\033[2;1H"     // a frame that only rewrites some rows, with it
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Samples for one kind of input
+struct kind {
+    const char *name;
+    uint64_t *ns;
+    size_t n, cap;
+    uint64_t frames, bytes;
+};
+
+enum { TYPING, ARROW, PASTE, INSERT, APPEND, DELETE, KINDS };
+
+static struct kind kinds[KINDS] = {
+    { "typing", NULL, 0, 0, 0, 0 },
+    { "arrow", NULL, 0, 0, 0, 0 },
+    { "paste", NULL, 0, 0, 0, 0 },
+    { "i command", NULL, 0, 0, 0, 0 },
+    { "a command", NULL, 0, 0, 0, 0 },
+    { "d command", NULL, 0, 0, 0, 0 },
+};
+
+static int master = -1;
+static char *out;               // output since the last input
+static size_t out_len, out_cap;
+static char cmd[1024];          // what the prompt should show
+static size_t cmd_len;
+static char *model[MAX_LINES];  // the buffer as the edits should leave it
+static size_t model_count;
+
+static size_t count(const char *what) {
+    size_t n = 0, len = strlen(what);
+    for (const char *p = out; (p = memmem(p, out + out_len - p, what, len)); p += len) n++;
+    return n;
+}
+
+static size_t count_frames(void) {
+    return count(CLEAR) + count(PARTIAL);
+}
+
+// The last frame is complete: it ends with the prompt and the command
+static int frame_done(void) {
+    char prompt[sizeof(cmd) + 2];
+    size_t len = (size_t)snprintf(prompt, sizeof(prompt), ": %s", cmd);
+    return count_frames() && out_len >= len && memcmp(out + out_len - len, prompt, len) == 0;
+}
+
+// Write input, then read until its frame is complete; -1 on a timeout
+static int send_input(int kind, const char *bytes, size_t len) {
+    out_len = 0;
+    uint64_t start = now_ns();
+    if (write(master, bytes, len) != (ssize_t)len) return -1;
+    for (;;) {
+        if (frame_done()) break;
+        int left = FRAME_TIMEOUT_MS - (int)((now_ns() - start) / 1000000);
+        struct pollfd p = { master, POLLIN, 0 };
+        if (left <= 0 || poll(&p, 1, left) <= 0) return -1;
+        if (out_cap - out_len < 65536) {
+            char *grown = realloc(out, out_cap + 65536);
+            if (!grown) return -1;
+            out = grown;
+            out_cap += 65536;
+        }
+        ssize_t n = read(master, out + out_len, out_cap - out_len);
+        if (n <= 0) return -1;
+        out_len += (size_t)n;
+    }
+    uint64_t ns = now_ns() - start;
+
+    struct kind *k = &kinds[kind];
+    if (k->n == k->cap) {
+        size_t cap = k->cap ? k->cap * 2 : 1024;
+        uint64_t *grown = realloc(k->ns, cap * sizeof(uint64_t));
+        if (!grown) return -1;
+        k->ns = grown;
+        k->cap = cap;
+    }
+    k->ns[k->n++] = ns;
+    k->frames += count_frames();
+    k->bytes += out_len;
+    return 0;
+}
+
+static int type_text(const char *text) {
+    for (; *text; ++text) {
+        cmd[cmd_len++] = *text;
+        cmd[cmd_len] = '\0';
+        if (send_input(TYPING, text, 1) < 0) return -1;
+    }
+    return 0;
+}
+
+static int enter(int kind) {
+    cmd_len = 0;
+    cmd[0] = '\0';
+    return send_input(kind, "\r", 1);
+}
+
+static int model_insert(size_t at, const char *text) {
+    char *copy = strdup(text);
+    if (!copy || model_count == MAX_LINES || at == 0 || at > model_count + 1) {
+        free(copy);
+        return -1;
+    }
+    memmove(model + at, model + at - 1, (model_count - at + 1) * sizeof(char *));
+    model[at - 1] = copy;
+    model_count++;
+    return 0;
+}
+
+static void model_delete(size_t at) {
+    free(model[at - 1]);
+    memmove(model + at - 1, model + at, (model_count - at) * sizeof(char *));
+    model_count--;
+}
+
+// The last input redrew the whole screen, and each numbered row on it
+// shows the model's line
+static int frame_shows_model(void) {
+    const char *p = NULL;
+    for (const char *q = out; (q = memmem(q, out + out_len - q, CLEAR, strlen(CLEAR)));
+         q += strlen(CLEAR))
+        p = q;
+    if (!p) return 0;
+
+    size_t rows = 0;
+    for (const char *end = out + out_len; p < end;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        if (len && p[len - 1] == '\r') len--;
+        size_t no;
+        int skip = 0;
+        char row[256];
+        snprintf(row, sizeof(row), "%.*s", (int)len, p);
+        if (sscanf(row, "%zu | %n", &no, &skip) == 1 && skip) {
+            if (no == 0 || no > model_count) return 0;
+            size_t shown = strlen(row + skip);   // clipped at COLS
+            if (strncmp(row + skip, model[no - 1], shown) != 0) return 0;
+            rows++;
+        }
+        p = nl ? nl + 1 : end;
+    }
+    return rows > 0;
+}
+
+// Enter an edit, then check that it landed
+static int enter_edit(int kind) {
+    if (enter(kind) < 0) return -1;
+    if (frame_shows_model()) return 0;
+    fprintf(stderr, "bench_latency: the %s was not applied\n", kinds[kind].name);
+    return -2;
+}
+
+// -1 on a timeout, -2 when an edit did not land
+static int round_trip(unsigned round) {
+    char text[128], line[64];
+    size_t at = 1 + (size_t)rand() % model_count;
+    int err;
+
+    snprintf(line, sizeof(line), "inserted in round %u", round);
+    snprintf(text, sizeof(text), "i %zu %s", at, line);
+    if (type_text(text) < 0 || model_insert(at, line) < 0) return -1;
+    if ((err = enter_edit(INSERT)) < 0) return err;
+
+    for (int i = 0; i < 10; ++i)
+        if (send_input(ARROW, "\033[B", 3) < 0) return -1;
+    for (int i = 0; i < 10; ++i)
+        if (send_input(ARROW, "\033[A", 3) < 0) return -1;
+
+    // A paste arrives as one write; the frame that counts is the last
+    snprintf(cmd, sizeof(cmd), "a pasted %u: the quick brown fox jumps over the lazy dog", round);
+    cmd_len = strlen(cmd);
+    if (send_input(PASTE, cmd, cmd_len) < 0 || model_insert(model_count + 1, cmd + 2) < 0)
+        return -1;
+    if ((err = enter_edit(APPEND)) < 0) return err;
+
+    snprintf(text, sizeof(text), "d %zu", at);
+    if (type_text(text) < 0) return -1;
+    model_delete(at);
+    return enter_edit(DELETE);
+}
+
+static void report(const struct kind *k) {
+    if (!k->n) return;
+    qsort(k->ns, k->n, sizeof(uint64_t), cmp_u64);
+    printf("%-12s %8zu %12.1f %12.1f %12.1f %14.0f\n", k->name, k->n,
+           k->ns[k->n / 2] / 1e3, k->ns[k->n * 99 / 100] / 1e3,
+           (double)k->frames / k->n, k->frames ? (double)k->bytes / k->frames : 0.0);
+}
+
+int main(int argc, char **argv) {
+    const char *editor = argc > 1 ? argv[1] : "./editor";
+    unsigned rounds = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 50;
+    size_t lines = argc > 2 ? strtoul(argv[2], NULL, 10)
+                 : rounds < MAX_LINES ? MAX_LINES - rounds - 1 : 0;
+    if (!lines || !rounds) return 1;
+    if (lines + rounds + 1 > MAX_LINES) {   // a line per round, and one until its delete
+        fprintf(stderr, "bench_latency: %zu lines and %u rounds do not fit in %d lines\n",
+                lines, rounds, MAX_LINES);
+        return 1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/bench_latency_%d.txt", (int)getpid());
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    for (size_t i = 0; i < lines; ++i) {
+        char line[128];
+        snprintf(line, sizeof(line), "line %zu: static int parse_header(const char *buf, size_t len);",
+                 i + 1);
+        fprintf(f, "%s\n", line);
+        if (model_insert(i + 1, line) < 0) {
+            fclose(f);
+            unlink(path);
+            return 1;
+        }
+    }
+    fclose(f);
+
+    struct winsize ws = { ROWS, COLS, 0, 0 };
+    pid_t pid = forkpty(&master, NULL, NULL, &ws);
+    if (pid < 0) {
+        perror("forkpty");
+        return 1;
+    }
+    if (pid == 0) {
+        execl(editor, editor, path, (char *)NULL);
+        perror(editor);
+        _exit(127);
+    }
+
+    // The first frame, then the script
+    int err = send_input(TYPING, "", 0);
+    kinds[TYPING].n = kinds[TYPING].frames = kinds[TYPING].bytes = 0;
+    srand(42);
+    for (unsigned r = 0; !err && r < rounds; ++r) err = round_trip(r);
+    int ok = !err;
+    if (err == -1) fprintf(stderr, "bench_latency: no complete frame within %d ms\n", FRAME_TIMEOUT_MS);
+
+    if (!ok || write(master, "q\r", 2) != 2) kill(pid, SIGKILL);     // a command may be half typed
+    waitpid(pid, NULL, 0);
+    close(master);
+    unlink(path);
+    if (!ok) return 1;
+
+    printf("%s, %zu lines, %dx%d terminal, %u rounds\n\n", editor, lines, COLS, ROWS, rounds);
+    printf("%-12s %8s %12s %12s %12s %14s\n",
+           "input", "samples", "p50 us", "p99 us", "frames", "bytes/frame");
+    for (int k = 0; k < KINDS; ++k) report(&kinds[k]);
+    free(out);
+    while (model_count) model_delete(model_count);
+    return 0;
+}
@@ -0,0 +1,88 @@
+/* bench_syntax.c - cost of compiling syntax definitions and of lexing
+   with the compiled tables compared to the hand-written highlighter.
+
+   gcc -O2 -pthread -DMAX_LINES=200000 -I. -o bench_syntax \
+       bench/bench_syntax.c buffer.c diff.c editor.c edits.c follow.c highlight.c input.c \
+       pager.c reload.c search.c stats.c stream.c stream_gz.c syntax.c trace.c trigram.c watch.c -lz
+   ./bench_syntax [syntax/c.syn ...]
+*/
+#include "editor.h"
+#include "highlight.h"
+#include "syntax.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#define COMPILE_RUNS 50
+#define LEX_LINES 100000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Lex every buffer line in order, returns MB/s
+static double lex_all(const struct highlighter *h, unsigned char *attrs) {
+    size_t bytes = 0;
+    int state = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < line_count; ++i) {
+        state = h->lex(h, lines[i], state, attrs);
+        bytes += strlen(lines[i]);
+    }
+    return bytes / 1e6 / ((now_ns() - start) / 1e9);
+}
+
+int main(int argc, char **argv) {
+    static const char *const defaults[] = { "syntax/c.syn", "syntax/log.syn" };
+    const char *const *files = argc > 1 ? (const char *const *)argv + 1 : defaults;
+    int file_count = argc > 1 ? argc - 1 : 2;
+    char err[256];
+
+    printf("%-20s %8s %8s %12s %12s\n", "definition", "rules", "states", "mean us", "min us");
+    struct syntax *c_syntax = NULL;
+    for (int f = 0; f < file_count; ++f) {
+        uint64_t total = 0, best = UINT64_MAX;
+        struct syntax *sx = NULL;
+        for (int run = 0; run < COMPILE_RUNS; ++run) {
+            syn_free(sx);
+            if (!(sx = syn_compile_file(files[f], err, sizeof(err)))) {
+                fprintf(stderr, "%s\n", err);
+                return 1;
+            }
+            total += sx->compile_ns;
+            if (sx->compile_ns < best) best = sx->compile_ns;
+        }
+        printf("%-20s %8zu %8zu %12.1f %12.1f\n", files[f], sx->rule_count,
+               syn_state_count(sx), total / 1e3 / COMPILE_RUNS, best / 1e3);
+        if (!c_syntax && strcmp(sx->name, "C") == 0) c_syntax = sx;
+        else syn_free(sx);
+    }
+    if (!c_syntax) return 0;
+
+    // Lexing throughput on a synthetic C buffer
+    static const char *const body[] = {
+        "static int parse_header(const char *buf, size_t len) {",
+        "    for (size_t i = 0; i < len; ++i) {",
+        "        if (buf[i] == '\\n') return (int)i; // end of header",
+        "    }",
+        "    return -1;",
+        "}",
+        "/* Multi-line comment describing the next function,",
+        "   spanning a few lines like real code does. */",
+        "#define HEADER_MAX 4096",
+        "",
+    };
+    for (size_t i = 0; i < LEX_LINES && i < MAX_LINES; ++i)
+        insert_line(line_count + 1, body[i % (sizeof(body) / sizeof(body[0]))]);
+
+    static unsigned char attrs[MAX_LINE_LEN];
+    lex_all(&hl_c, attrs);
+    printf("\nlexing %zu lines: built-in C %.1f MB/s, compiled C %.1f MB/s\n",
+           line_count, lex_all(&hl_c, attrs), lex_all(&c_syntax->hl, attrs));
+
+    syn_free(c_syntax);
+    for (size_t i = 0; i < line_count; ++i) free(lines[i]);
+    return 0;
+}
@@ -0,0 +1,76 @@
+/* bench_trace.c - cost of a traced span
+   Times TRACE_BEGIN/TRACE_END pairs around an empty body, on one thread
+   and then on several at once (each writes its own ring), against the
+   same loop built without tracing; then times "trace FILE" writing out
+   the full rings.
+
+   gcc -O2 -pthread -DZEPTEX_TRACE -I. -o bench_trace \
+       bench/bench_trace.c buffer.c diff.c editor.c edits.c follow.c highlight.c input.c \
+       pager.c reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz
+   ./bench_trace [spans] [threads]      (default: 10000000 4)
+*/
+#include "editor.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+static size_t spans = 10000000;
+static volatile size_t sink;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);   // threads may share a CPU
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void *untraced(void *arg) {
+    uint64_t *ns = arg, start = now_ns();
+    for (size_t i = 0; i < spans; ++i) sink = i;
+    *ns = now_ns() - start;
+    return NULL;
+}
+
+static void *traced(void *arg) {
+    uint64_t *ns = arg, start = now_ns();
+    for (size_t i = 0; i < spans; ++i) {
+        uint64_t t = TRACE_BEGIN();
+        sink = i;
+        TRACE_END(t, "bench");
+    }
+    *ns = now_ns() - start;
+    return NULL;
+}
+
+// Mean ns per span over threads running body at once
+static double run(void *(*body)(void *), int threads) {
+    pthread_t tid[64];
+    uint64_t ns[64], total = 0;
+    for (int i = 0; i < threads; ++i) pthread_create(&tid[i], NULL, body, &ns[i]);
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(tid[i], NULL);
+        total += ns[i];
+    }
+    return (double)total / threads / spans;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) spans = strtoul(argv[1], NULL, 10);
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    if (!spans || threads < 1 || threads > 64) return 1;
+
+    printf("%zu spans per thread\n\n", spans);
+    printf("%-8s %12s %12s %12s\n", "threads", "loop ns", "traced ns", "span ns");
+    for (int n = 1; n <= threads; n = n == threads ? n + 1 : (n * 2 > threads ? threads : n * 2)) {
+        double base = run(untraced, n), with = run(traced, n);
+        printf("%-8d %12.2f %12.2f %12.2f\n", n, base, with, with - base);
+    }
+
+    const char *path = "/tmp/bench_trace.json";
+    uint64_t start = now_ns();
+    trace_command(path);
+    printf("\ntrace %s: %.1f ms\n", path, (now_ns() - start) / 1e6);
+    remove(path);
+    return 0;
+}
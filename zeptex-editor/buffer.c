@@ -0,0 +1,177 @@
+#include "editor.h"
+#include "buffer.h"
+#include "highlight.h"
+#include "reload.h"
+#include "search.h"
+#include "trigram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static struct buffer **list;
+static size_t count, cap;
+static size_t shown;        // index of the buffer in view
+
+// Parking
+
+static void park(struct buffer *b) {
+    b->line_count = line_count;
+    b->scroll_offset = scroll_offset;
+    b->scroll_col = scroll_col;
+    b->dirty = buffer_dirty;
+    b->hl = hl_park();
+    b->tri = tri_park();
+    b->search = search_park();
+    b->reload = reload_park();
+}
+
+static void unpark(struct buffer *b) {
+    lines = b->lines;
+    line_count = b->line_count;
+    scroll_offset = b->scroll_offset;
+    scroll_col = b->scroll_col;
+    buffer_dirty = b->dirty;
+    hl_unpark(b->hl);
+    tri_unpark(b->tri);
+    search_unpark(b->search);
+    reload_unpark(b->reload);
+    b->hl = b->tri = b->search = b->reload = NULL;
+}
+
+static void show(size_t i) {
+    if (i == shown) return;
+    park(list[shown]);
+    shown = i;
+    unpark(list[shown]);
+    const struct buffer *b = list[shown];
+    set_status("[%zu/%zu] %s, %zu lines%s", shown + 1, count,
+               b->filename ? b->filename : b->scratch ? b->scratch : "(unnamed)",
+               line_count, buffer_dirty ? ", modified" : "");
+}
+
+static struct buffer *buffer_add(char **slots, const char *filename) {
+    if (count == cap) {
+        size_t grown_cap = cap ? cap * 2 : 8;
+        struct buffer **grown = realloc(list, grown_cap * sizeof(*grown));
+        if (!grown) return NULL;
+        list = grown;
+        cap = grown_cap;
+    }
+    struct buffer *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+    b->lines = slots;
+    b->filename = filename ? strdup(filename) : NULL;
+    if (filename && !b->filename) {
+        free(b);
+        return NULL;
+    }
+    list[count++] = b;
+    return b;
+}
+
+static int same_file(const char *a, const char *b) {
+    struct stat sa, sb;
+    if (stat(a, &sa) == 0 && stat(b, &sb) == 0)
+        return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    return strcmp(a, b) == 0;
+}
+
+// Public interface
+
+// The buffer main() loads before the editor starts becomes the first
+// one; it keeps editor.c's static line array
+int buffer_init(const char *filename) {
+    return buffer_add(lines, filename) ? 0 : -1;
+}
+
+int buffer_open(const char *filename) {
+    for (size_t i = 0; i < count; ++i) {
+        if (list[i]->filename && same_file(list[i]->filename, filename)) {
+            show(i);
+            return 0;
+        }
+    }
+
+    char **slots = calloc(MAX_LINES, sizeof(char *));
+    struct buffer *b = slots ? buffer_add(slots, filename) : NULL;
+    if (!b) {
+        free(slots);
+        set_status("%s: out of memory", filename);
+        return -1;
+    }
+
+    // A new buffer is loaded like the first one, indexed if that one is
+    park(list[shown]);
+    int indexed = list[shown]->tri != NULL;
+    shown = count - 1;
+    unpark(b);
+    load_file(filename);
+    reload_watch(filename);
+    hl_select(filename);
+    if (indexed) tri_enable();
+    set_status("[%zu/%zu] %s, %zu lines", shown + 1, count, filename, line_count);
+    return 0;
+}
+
+// A buffer for text the editor makes up, found again by its name; the
+// caller fills it
+int buffer_scratch(const char *name) {
+    size_t i = 0;
+    while (i < count && !(list[i]->scratch && strcmp(list[i]->scratch, name) == 0)) i++;
+    if (i < count) {
+        show(i);
+    } else {
+        char **slots = calloc(MAX_LINES, sizeof(char *));
+        struct buffer *b = slots ? buffer_add(slots, NULL) : NULL;
+        if (b && !(b->scratch = strdup(name))) {
+            count--;
+            free(b);
+            b = NULL;
+        }
+        if (!b) {
+            free(slots);
+            set_status("%s: out of memory", name);
+            return -1;
+        }
+        park(list[shown]);
+        shown = count - 1;
+        unpark(b);
+        set_status("[%zu/%zu] %s", shown + 1, count, name);
+    }
+    while (line_count) delete_line(line_count);
+    return 0;
+}
+
+void buffer_cycle(int dir) {
+    if (count < 2) {
+        set_status("No other buffers");
+        return;
+    }
+    show(dir > 0 ? (shown + 1) % count : (shown + count - 1) % count);
+}
+
+const char *buffer_name(void) {
+    return count ? list[shown]->filename : NULL;
+}
+
+// Free every buffer and its module state
+void buffer_close_all(void) {
+    struct buffer empty = { NULL, 0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL };
+    if (count) {
+        empty.lines = list[0]->lines;
+        park(list[shown]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        unpark(list[i]);
+        for (size_t j = 0; j < line_count; ++j) free(lines[j]);
+        unpark(&empty);             // drops the module state just restored
+        if (i) free(list[i]->lines);    // the first uses the static array
+        free(list[i]->filename);
+        free(list[i]->scratch);
+        free(list[i]);
+    }
+    free(list);
+    list = NULL;
+    count = cap = shown = 0;
+}
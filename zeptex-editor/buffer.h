@@ -0,0 +1,36 @@
+/* buffer.h - several files open at once, one of them in view
+   The editor works on the globals in editor.h (lines, line_count,
+   scroll_offset, scroll_col, buffer_dirty), which always describe the
+   buffer in view.  Switching parks them, together with the highlight
+   cache, the trigram index, the last search and the file watch, in the
+   buffer being left and restores those of the buffer being shown.
+   Nothing is copied, re-lexed or re-indexed, so a switch costs the same
+   whatever the size of either buffer.
+*/
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>   /* for size_t */
+
+struct buffer {
+    char **lines;           /* MAX_LINES slots                          */
+    size_t line_count;      /* these four are only up to date while     */
+    size_t scroll_offset;   /* the buffer is parked                     */
+    size_t scroll_col;
+    int dirty;
+    char *filename;         /* NULL for an unnamed buffer               */
+    char *scratch;          /* name of a scratch buffer, which has none */
+    void *hl, *tri, *search, *reload;   /* parked module state          */
+};
+
+/*--------------------------------------------------------------------
+  Buffer list
+ --------------------------------------------------------------------*/
+int  buffer_init(const char *filename);    /* adopt the initial buffer  */
+int  buffer_open(const char *filename);    /* e FILE: open or switch    */
+int  buffer_scratch(const char *name);     /* switch to it, emptied     */
+void buffer_cycle(int dir);                /* bn +1, bp -1              */
+const char *buffer_name(void);             /* file of the buffer in view */
+void buffer_close_all(void);
+
+#endif /* BUFFER_H */
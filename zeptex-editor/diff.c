@@ -0,0 +1,706 @@
+#include "editor.h"
+#include "buffer.h"
+#include "diff.h"
+#include "stream.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATCH_FUZZ 2        // context lines that may be ignored at each end
+#define DIFF_MAX_COST 1024  // least edit cost before the diff settles for a guess
+#define DIFF_ANCHOR_COST 256    // the same when there is an anchor to split at
+#define DIFF_CONTEXT 3      // unchanged rows shown above the first change
+
+uint64_t line_hash(const char *s, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ull;     // FNV-1a
+    for (size_t i = 0; i < len; ++i) h = (h ^ (unsigned char)s[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// Lines by hash
+
+struct line_table {
+    const uint64_t *hash;   // per line, owned by the caller
+    size_t *head;           // per bucket: first line in it + 1, 0 = none
+    size_t *next;           // per line: next line in the same bucket + 1
+    size_t mask;
+};
+
+static uint64_t *hash_lines(char **l, size_t n) {
+    uint64_t *h = malloc((n + 1) * sizeof(uint64_t));
+    for (size_t i = 0; h && i < n; ++i) h[i] = line_hash(l[i], strlen(l[i]));
+    return h;
+}
+
+static void table_free(struct line_table *t) {
+    free(t->head);
+    free(t->next);
+    t->head = t->next = NULL;
+}
+
+static int table_build(struct line_table *t, const uint64_t *hash, size_t n) {
+    size_t buckets = 16;
+    while (buckets < n * 2) buckets *= 2;
+    t->hash = hash;
+    t->head = calloc(buckets, sizeof(size_t));
+    t->next = malloc((n + 1) * sizeof(size_t));
+    t->mask = buckets - 1;
+    if (!hash || !t->head || !t->next) {
+        table_free(t);
+        return -1;
+    }
+    for (size_t i = n; i-- > 0;) {      // chains in line order
+        size_t b = hash[i] & t->mask;
+        t->next[i] = t->head[b];
+        t->head[b] = i + 1;
+    }
+    return 0;
+}
+
+// Patch text
+
+struct hunk {
+    size_t old_start, old_count, new_count;
+    size_t first, end;      // body: patch lines [first, end)
+};
+
+// Text of a body line without its ' ', '-' or '+'; an empty line is
+// context whose trailing space was lost
+static const char *body_text(const char *l) {
+    return l[0] ? l + 1 : l;
+}
+
+static int is_context(const char *l) {
+    return l[0] == ' ' || l[0] == '\0';
+}
+
+// "@@ -a[,b] +c[,d] @@ ..."
+static int parse_header(const char *s, struct hunk *h) {
+    char *end;
+    if (strncmp(s, "@@ -", 4) != 0) return -1;
+    h->old_start = strtoul(s + 4, &end, 10);
+    h->old_count = 1;
+    if (*end == ',') h->old_count = strtoul(end + 1, &end, 10);
+    if (end[0] != ' ' || end[1] != '+') return -1;
+    strtoul(end + 2, &end, 10);
+    h->new_count = 1;
+    if (*end == ',') h->new_count = strtoul(end + 1, &end, 10);
+    return strncmp(end, " @@", 3) == 0 ? 0 : -1;
+}
+
+// Take the body lines the header counts, 0 if the patch is cut short
+static int read_body(char **pl, size_t pn, size_t i, struct hunk *h) {
+    size_t old = 0, new = 0;
+    h->first = i;
+    while (i < pn && (old < h->old_count || new < h->new_count)) {
+        if (is_context(pl[i])) {
+            old++;
+            new++;
+        } else if (pl[i][0] == '-') {
+            old++;
+        } else if (pl[i][0] == '+') {
+            new++;
+        } else if (pl[i][0] != '\\') {  // "\ No newline at end of file"
+            break;
+        }
+        i++;
+    }
+    if (i < pn && pl[i][0] == '\\') i++;
+    h->end = i;
+    return old == h->old_count && new == h->new_count;
+}
+
+// Hunk location
+
+struct image {
+    const char **text;      // old lines of the hunk, context and removed
+    uint64_t *hash;
+    size_t n;
+};
+
+static int matches(const struct line_table *t, const struct image *im, size_t at) {
+    if (at + im->n > line_count) return 0;
+    for (size_t k = 0; k < im->n; ++k)
+        if (t->hash[at + k] != im->hash[k] || strcmp(lines[at + k], im->text[k]) != 0)
+            return 0;
+    return 1;
+}
+
+// Start of the old text in the buffer, at or after from and nearest to
+// want, or -1.  Only the places holding its rarest line are compared.
+static long locate(const struct line_table *t, const struct image *im, size_t from, size_t want) {
+    if (!im->n) return want < from ? (long)from : want > line_count ? (long)line_count : (long)want;
+    if (want >= from && matches(t, im, want)) return (long)want;
+
+    size_t anchor = 0, best = SIZE_MAX;
+    for (size_t j = 0; j < im->n && best > 1; ++j) {
+        size_t occ = 0;
+        for (size_t p = t->head[im->hash[j] & t->mask]; p && occ < best; p = t->next[p - 1])
+            occ += t->hash[p - 1] == im->hash[j];
+        if (occ < best) {
+            best = occ;
+            anchor = j;
+        }
+    }
+    if (!best) return -1;
+
+    long found = -1;
+    size_t dist = SIZE_MAX;
+    for (size_t p = t->head[im->hash[anchor] & t->mask]; p; p = t->next[p - 1]) {
+        size_t at = p - 1;
+        if (t->hash[at] != im->hash[anchor] || at < anchor) continue;
+        size_t s = at - anchor;
+        if (s < from || !matches(t, im, s)) continue;
+        size_t d = s > want ? s - want : want - s;
+        if (d < dist) {
+            dist = d;
+            found = (long)s;
+        }
+    }
+    return found;
+}
+
+// Shortest edit script (Myers), as GNU diff computes it
+
+struct myers {
+    const size_t *a, *b;    // line classes of both sides, less the lines only one side has
+    const size_t *amap, *bmap;  // their line numbers in the full sides
+    char *del, *ins;
+    const size_t *ax, *by;  // anchor pairs, increasing on both sides
+    size_t anchors;
+    long *fd, *bd;          // per diagonal x - y: furthest x forward, backward
+    long too_expensive;     // edit cost past which a split is guessed
+};
+
+// First anchor at or past line x of a and line y of b
+static size_t first_anchor(const struct myers *m, long x, long y) {
+    size_t lo = 0, hi = m->anchors;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if ((long)m->ax[mid] < x || (long)m->by[mid] < y) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// A point on a middle snake of a[x0,x1) against b[y0,y1).  Past a set
+// edit cost the middle anchor in the range is taken instead, or when
+// there is none (after the larger too_expensive) the diagonal that got
+// furthest, which keeps very different inputs near linear at the cost
+// of a longer script.
+static void midpoint(struct myers *m, long x0, long x1, long y0, long y1, long *sx, long *sy) {
+    const size_t *a = m->a, *b = m->b;
+    long *fd = m->fd, *bd = m->bd;
+    long dmin = x0 - y1, dmax = x1 - y0;
+    long fmid = x0 - y0, bmid = x1 - y1;
+    long fmin = fmid, fmax = fmid, bmin = bmid, bmax = bmid;
+    int odd = (fmid - bmid) & 1;
+    size_t lo = first_anchor(m, x0, y0), hi = first_anchor(m, x1, y1);
+    int anchored = lo < hi;
+    fd[fmid] = x0;
+    bd[bmid] = x1;
+
+    for (long c = 1;; ++c) {
+        if (fmin > dmin) fd[--fmin - 1] = -1;
+        else ++fmin;
+        if (fmax < dmax) fd[++fmax + 1] = -1;
+        else --fmax;
+        for (long d = fmax; d >= fmin; d -= 2) {
+            long lo = fd[d - 1], hi = fd[d + 1];
+            long x = lo < hi ? hi : lo + 1, y = x - d;
+            while (x < x1 && y < y1 && a[x] == b[y]) x++, y++;
+            fd[d] = x;
+            if (odd && bmin <= d && d <= bmax && bd[d] <= x) {
+                *sx = x;
+                *sy = y;
+                return;
+            }
+        }
+
+        if (bmin > dmin) bd[--bmin - 1] = LONG_MAX;
+        else ++bmin;
+        if (bmax < dmax) bd[++bmax + 1] = LONG_MAX;
+        else --bmax;
+        for (long d = bmax; d >= bmin; d -= 2) {
+            long lo = bd[d - 1], hi = bd[d + 1];
+            long x = lo < hi ? lo : hi - 1, y = x - d;
+            while (x > x0 && y > y0 && a[x - 1] == b[y - 1]) x--, y--;
+            bd[d] = x;
+            if (!odd && fmin <= d && d <= fmax && x <= fd[d]) {
+                *sx = x;
+                *sy = y;
+                return;
+            }
+        }
+
+        if (c < DIFF_ANCHOR_COST || (c < m->too_expensive && !anchored)) continue;
+        if (anchored) {
+            size_t k = lo + (hi - lo) / 2;
+            *sx = (long)m->ax[k];
+            *sy = (long)m->by[k];
+            return;
+        }
+        long fbest = -1, fx = x0, bbest = LONG_MAX, bx = x1;
+        for (long d = fmax; d >= fmin; d -= 2) {    // forward: largest x + y
+            long x = fd[d] < x1 ? fd[d] : x1, y = x - d;
+            if (y > y1) {
+                x = y1 + d;
+                y = y1;
+            }
+            if (x + y > fbest) {
+                fbest = x + y;
+                fx = x;
+            }
+        }
+        for (long d = bmax; d >= bmin; d -= 2) {    // backward: smallest x + y
+            long x = bd[d] > x0 ? bd[d] : x0, y = x - d;
+            if (y < y0) {
+                x = y0 + d;
+                y = y0;
+            }
+            if (x + y < bbest) {
+                bbest = x + y;
+                bx = x;
+            }
+        }
+        if ((x1 + y1) - bbest < fbest - (x0 + y0)) {
+            *sx = fx;
+            *sy = fbest - fx;
+        } else {
+            *sx = bx;
+            *sy = bbest - bx;
+        }
+        return;
+    }
+}
+
+static void compare(struct myers *m, long x0, long x1, long y0, long y1) {
+    for (;;) {
+        while (x0 < x1 && y0 < y1 && m->a[x0] == m->b[y0]) x0++, y0++;
+        while (x0 < x1 && y0 < y1 && m->a[x1 - 1] == m->b[y1 - 1]) x1--, y1--;
+        if (x0 == x1) {
+            while (y0 < y1) m->ins[m->bmap[y0++]] = 1;
+            return;
+        }
+        if (y0 == y1) {
+            while (x0 < x1) m->del[m->amap[x0++]] = 1;
+            return;
+        }
+        long x, y;
+        midpoint(m, x0, x1, y0, y1, &x, &y);
+        compare(m, x0, x, y0, y);
+        x0 = x;             // the second half in this loop
+        y0 = y;
+    }
+}
+
+// Lines as equivalence classes: equal lines (by hash) share a number
+
+struct classes {
+    uint64_t *key;
+    size_t *id;             // per slot: class + 1, 0 = empty
+    size_t mask, n;
+};
+
+static size_t class_of(struct classes *c, uint64_t h) {
+    size_t slot = (size_t)(h ^ h >> 32) & c->mask;
+    while (c->id[slot] && c->key[slot] != h) slot = (slot + 1) & c->mask;
+    if (!c->id[slot]) {
+        c->key[slot] = h;
+        c->id[slot] = ++c->n;
+    }
+    return c->id[slot] - 1;
+}
+
+// Anchors (patience): of the lines that occur once on each side, the
+// longest run whose order both sides agree on, by patience sorting.
+// Fills ax/by with the kept pairs in order and returns how many.
+static size_t anchors(size_t *ax, size_t *by, size_t k, size_t *prev, size_t *tails) {
+    size_t len = 0;
+    for (size_t i = 0; i < k; ++i) {
+        size_t lo = 0, hi = len;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (by[tails[mid]] < by[i]) lo = mid + 1;
+            else hi = mid;
+        }
+        prev[i] = lo ? tails[lo - 1] : SIZE_MAX;
+        tails[lo] = i;
+        if (lo == len) len++;
+    }
+    // Walk the chain back into tails, then copy the pairs forward;
+    // tails[j] >= j, so nothing is overwritten before it is read
+    size_t j = len;
+    for (size_t i = len ? tails[len - 1] : SIZE_MAX; i != SIZE_MAX; i = prev[i]) tails[--j] = i;
+    for (j = 0; j < len; ++j) {
+        ax[j] = ax[tails[j]];
+        by[j] = by[tails[j]];
+    }
+    return len;
+}
+
+// Diff view
+
+enum { ROW_SAME, ROW_ADDED, ROW_REMOVED };
+
+struct diff_row {
+    unsigned char kind;
+    size_t index;           // buffer line, or file line when removed
+};
+
+static struct {
+    char **disk;            // the file's lines, for removed rows
+    size_t disk_count;
+    struct diff_row *rows;
+    size_t count, top;
+    int active;
+} view;
+
+// Public interface
+
+int patch_apply(const char *path) {
+    struct stream *s = stream_open(path, STREAM_READ);
+    if (!s) {
+        set_status("%s: %s", path, strerror(errno));
+        return -1;
+    }
+    char **pl = NULL, *l;
+    size_t pn = 0, pcap = 0;
+    while ((l = stream_getline(s, NULL))) {
+        if (pn == pcap) {
+            size_t cap = pcap ? pcap * 2 : 256;
+            char **grown = realloc(pl, cap * sizeof(char *));
+            if (!grown) {
+                free(l);
+                break;
+            }
+            pl = grown;
+            pcap = cap;
+        }
+        pl[pn++] = l;
+    }
+    stream_close(s);
+
+    struct line_table t = { NULL, NULL, NULL, 0 };
+    struct image im;
+    uint64_t *hash = hash_lines(lines, line_count);
+    zx_edit *edits = malloc((pn + 1) * sizeof(zx_edit));    // one per line at most
+    im.text = malloc((pn + 1) * sizeof(char *));
+    im.hash = malloc((pn + 1) * sizeof(uint64_t));
+    int ok = edits && im.text && im.hash && table_build(&t, hash, line_count) == 0;
+
+    size_t hunks = 0, applied = 0, moved = 0, fuzzed = 0, n = 0;
+    size_t from = 0;        // buffer lines before this belong to earlier hunks
+    long offset = 0;        // where the last hunk was found, against its header
+    int more_files = 0;
+    char failed[128] = "";
+    for (size_t i = 0; ok && i < pn;) {
+        struct hunk h;
+        if (hunks && (strncmp(pl[i], "--- ", 4) == 0 || strncmp(pl[i], "diff ", 5) == 0)) {
+            more_files = 1;
+            break;
+        }
+        if (parse_header(pl[i], &h) < 0) {
+            i++;
+            continue;
+        }
+        int complete = read_body(pl, pn, i + 1, &h);
+        i = h.end;
+        hunks++;
+
+        // Context at either end, which fuzz may leave unchecked
+        size_t lead = 0, trail = 0, lines_in = 0;
+        for (size_t j = h.first; j < h.end; ++j) lines_in += pl[j][0] != '\\';
+        for (size_t j = h.first; j < h.end && is_context(pl[j]); ++j) lead++;
+        for (size_t j = h.end; j > h.first && (is_context(pl[j - 1]) || pl[j - 1][0] == '\\'); --j)
+            trail += pl[j - 1][0] != '\\';
+
+        long pos = -1;
+        size_t b0 = h.first, b1 = h.end, fuzz = 0;
+        for (; complete && lead < lines_in && pos < 0 && fuzz <= PATCH_FUZZ; ++fuzz) {
+            size_t skip_lead = fuzz < lead ? fuzz : lead;
+            size_t skip_trail = fuzz < trail ? fuzz : trail;
+            b0 = h.first + skip_lead;
+            b1 = h.end;
+            for (size_t k = skip_trail; k > 0; --b1) k -= pl[b1 - 1][0] != '\\';
+
+            im.n = 0;
+            for (size_t j = b0; j < b1; ++j) {
+                if (pl[j][0] == '+' || pl[j][0] == '\\') continue;
+                const char *text = body_text(pl[j]);
+                im.text[im.n] = text;
+                im.hash[im.n++] = line_hash(text, strlen(text));
+            }
+            long base = (long)(h.old_count ? h.old_start - 1 : h.old_start) + (long)skip_lead;
+            long want = base + offset;
+            pos = locate(&t, &im, from, want < 0 ? 0 : (size_t)want);
+            if (pos >= 0) {
+                offset = pos - base;
+                if (fuzz) fuzzed++;
+                else if (pos != want) moved++;
+            }
+        }
+        if (lead == lines_in && complete) {
+            applied++;          // context only, nothing to change
+            continue;
+        }
+        if (pos < 0) {
+            size_t used = strlen(failed);
+            if (used + 16 < sizeof(failed))
+                snprintf(failed + used, sizeof(failed) - used, " #%zu", hunks);
+            continue;
+        }
+
+        size_t at = (size_t)pos;
+        for (size_t j = b0; j < b1; ++j) {
+            if (is_context(pl[j])) {
+                at++;
+            } else if (pl[j][0] == '-') {
+                edits[n++] = (zx_edit){ ZX_DELETE, at++, NULL, 0 };
+            } else if (pl[j][0] == '+') {
+                edits[n++] = (zx_edit){ ZX_INSERT, at, pl[j] + 1, strlen(pl[j] + 1) };
+            }
+        }
+        from = at;
+        applied++;
+    }
+
+    if (!ok) {
+        set_status("patch: out of memory");
+    } else if (!hunks) {
+        set_status("patch: no hunks in %s", path);
+    } else if (n && apply_edits(edits, n) < 0) {
+        set_status("patch: %s", errno == ENOSPC ? "result would not fit the buffer" : strerror(errno));
+        ok = 0;
+    } else {
+        set_status("patch: %zu of %zu hunks applied (%zu moved, %zu with fuzz)%s%s%s",
+                   applied, hunks, moved, fuzzed, failed[0] ? ", failed:" : "", failed,
+                   more_files ? "; only the first file of the patch was used" : "");
+    }
+
+    table_free(&t);
+    free(hash);
+    free(edits);
+    free(im.text);
+    free(im.hash);
+    for (size_t i = 0; i < pn; ++i) free(pl[i]);
+    free(pl);
+    return ok && applied == hunks ? 0 : -1;
+}
+
+int diff_hashes(const uint64_t *a, size_t n, const uint64_t *b, size_t m, char *del, char *ins) {
+    memset(del, 0, n);
+    memset(ins, 0, m);
+    size_t head = 0, tail = 0;          // lines in common at either end
+    while (head < n && head < m && a[head] == b[head]) head++;
+    while (tail < n - head && tail < m - head && a[n - 1 - tail] == b[m - 1 - tail]) tail++;
+    if (head + tail == n || head + tail == m) {
+        for (size_t i = head; i < n - tail; ++i) del[i] = 1;
+        for (size_t j = head; j < m - tail; ++j) ins[j] = 1;
+        return 0;
+    }
+    n -= head + tail;
+    m -= head + tail;
+    a += head;
+    b += head;
+
+    size_t slots = 16, most = n < m ? n : m;
+    while (slots < (n + m) * 2) slots *= 2;
+    struct classes c = { malloc(slots * sizeof(uint64_t)), calloc(slots, sizeof(size_t)),
+                         slots - 1, 0 };
+    size_t *ka = malloc(n * sizeof(size_t)), *kb = malloc(m * sizeof(size_t));
+    size_t *amap = malloc(n * sizeof(size_t)), *bmap = malloc(m * sizeof(size_t));
+    size_t *count_a = calloc(n + m, sizeof(size_t)), *count_b = calloc(n + m, sizeof(size_t));
+    size_t *where_b = malloc((n + m) * sizeof(size_t));     // per class: its line in kb
+    size_t *ax = malloc(most * sizeof(size_t)), *by = malloc(most * sizeof(size_t));
+    size_t *prev = malloc(most * sizeof(size_t)), *tails = malloc(most * sizeof(size_t));
+    long *v = malloc(2 * (n + m + 3) * sizeof(long));
+    int ok = c.key && c.id && ka && kb && amap && bmap && count_a && count_b && where_b &&
+             ax && by && prev && tails && v;
+
+    if (ok) {
+        for (size_t i = 0; i < n; ++i) count_a[ka[i] = class_of(&c, a[i])]++;
+        for (size_t j = 0; j < m; ++j) count_b[kb[j] = class_of(&c, b[j])]++;
+
+        // A line only one side has cannot be common: mark it now and
+        // leave it out of the search
+        size_t an = 0, bn = 0, k = 0;
+        for (size_t j = 0; j < m; ++j) {
+            if (!count_a[kb[j]]) {
+                ins[head + j] = 1;
+                continue;
+            }
+            where_b[kb[j]] = bn;
+            kb[bn] = kb[j];
+            bmap[bn++] = head + j;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!count_b[ka[i]]) {
+                del[head + i] = 1;
+                continue;
+            }
+            if (count_a[ka[i]] == 1 && count_b[ka[i]] == 1) {
+                ax[k] = an;
+                by[k++] = where_b[ka[i]];
+            }
+            ka[an] = ka[i];
+            amap[an++] = head + i;
+        }
+
+        k = anchors(ax, by, k, prev, tails);
+        struct myers my = { ka, kb, amap, bmap, del, ins, ax, by, k,
+                            v + bn + 1, v + bn + 1 + (n + m + 3), 1 };
+        for (size_t d = an + bn + 3; d; d >>= 2) my.too_expensive <<= 1;
+        if (my.too_expensive < DIFF_MAX_COST) my.too_expensive = DIFF_MAX_COST;
+        compare(&my, 0, (long)an, 0, (long)bn);
+    }
+
+    free(c.key);
+    free(c.id);
+    free(ka);
+    free(kb);
+    free(amap);
+    free(bmap);
+    free(count_a);
+    free(count_b);
+    free(where_b);
+    free(ax);
+    free(by);
+    free(prev);
+    free(tails);
+    free(v);
+    if (!ok) errno = ENOMEM;
+    return ok ? 0 : -1;
+}
+
+int diff_open(void) {
+    const char *path = buffer_name();
+    if (!path) {
+        set_status("diff: the buffer has no file");
+        return -1;
+    }
+    struct stream *s = stream_open(path, STREAM_READ);
+    if (!s) {
+        set_status("%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    uint64_t *dh = NULL;
+    size_t cap = 0, len;
+    int ok = 1;
+    char *l;
+    diff_close();
+    while ((l = stream_getline(s, &len))) {
+        if (view.disk_count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            char **grown = realloc(view.disk, cap * sizeof(char *));
+            uint64_t *grown_h = grown ? realloc(dh, cap * sizeof(uint64_t)) : NULL;
+            if (grown) view.disk = grown;
+            if (grown_h) dh = grown_h;
+            if (!grown || !grown_h) {
+                free(l);
+                ok = 0;
+                break;
+            }
+        }
+        dh[view.disk_count] = line_hash(l, len);
+        view.disk[view.disk_count++] = l;
+    }
+    stream_close(s);
+
+    size_t dn = view.disk_count;
+    uint64_t *bh = hash_lines(lines, line_count);
+    char *del = malloc(dn + 1), *ins = malloc(line_count + 1);
+    view.rows = malloc((dn + line_count + 1) * sizeof(struct diff_row));
+    ok = ok && bh && del && ins && view.rows && diff_hashes(dh, dn, bh, line_count, del, ins) == 0;
+
+    size_t added = 0, removed = 0, first = SIZE_MAX;
+    for (size_t i = 0, j = 0; ok && (i < dn || j < line_count);) {
+        struct diff_row *r = &view.rows[view.count];
+        if (i < dn && (j == line_count || del[i])) {
+            *r = (struct diff_row){ ROW_REMOVED, i++ };
+            removed++;
+        } else if (j < line_count && (i == dn || ins[j])) {
+            *r = (struct diff_row){ ROW_ADDED, j++ };
+            added++;
+        } else {
+            *r = (struct diff_row){ ROW_SAME, j++ };
+            i++;
+        }
+        if (r->kind != ROW_SAME && first == SIZE_MAX) first = view.count;
+        view.count++;
+    }
+    free(dh);
+    free(bh);
+    free(del);
+    free(ins);
+
+    if (!ok) {
+        set_status("diff: out of memory");
+    } else if (!added && !removed) {
+        set_status("diff: no changes against %s", path);
+    } else {
+        set_status("diff against %s: %zu added, %zu removed", path, added, removed);
+        view.top = first > DIFF_CONTEXT ? first - DIFF_CONTEXT : 0;
+        view.active = 1;
+        return 0;
+    }
+    diff_close();
+    return ok ? 0 : -1;
+}
+
+int diff_active(void) {
+    return view.active;
+}
+
+void diff_close(void) {
+    for (size_t i = 0; i < view.disk_count; ++i) free(view.disk[i]);
+    free(view.disk);
+    free(view.rows);
+    memset(&view, 0, sizeof(view));
+}
+
+// The text of view row i, NULL past the end or for lines dropped since
+// (follow mode)
+static const char *row_text(size_t i) {
+    const struct diff_row *r = i < view.count ? &view.rows[i] : NULL;
+    if (!r || (r->kind != ROW_REMOVED && r->index >= line_count)) return NULL;
+    return r->kind == ROW_REMOVED ? view.disk[r->index] : lines[r->index];
+}
+
+void diff_draw(size_t rows, int cols) {
+    size_t max_top = view.count > rows ? view.count - rows : 0;
+    if (view.top > max_top) view.top = max_top;
+    for (size_t i = 0; i < rows; ++i) {
+        const char *text = row_text(view.top + i);
+        if (!text) {
+            printf("~\n");
+            continue;
+        }
+        const struct diff_row *r = &view.rows[view.top + i];
+        const char *colour = r->kind == ROW_REMOVED ? "\033[31m" : r->kind == ROW_ADDED ? "\033[32m" : "";
+        printf("%s", colour);
+        int prefix = printf("%c%3zu | ", r->kind == ROW_REMOVED ? '-' : r->kind == ROW_ADDED ? '+' : ' ',
+                            r->index + 1);
+        if (cols > prefix) draw_text(text, strlen(text), scroll_col, (size_t)(cols - prefix));
+        printf("%s\n", *colour ? "\033[0m" : "");
+    }
+}
+
+size_t diff_widest(size_t rows) {
+    size_t widest = 0;
+    for (size_t i = view.top; i < view.top + rows; ++i) {
+        const char *text = row_text(i);
+        size_t w = text ? text_width(text, strlen(text)) : 0;
+        if (w > widest) widest = w;
+    }
+    return widest;
+}
+
+void diff_scroll(int dir) {
+    if (dir < 0 && view.top > 0) view.top--;
+    else if (dir > 0 && view.top + 1 < view.count) view.top++;
+}
@@ -0,0 +1,48 @@
+/* diff.h - unified diffs against the buffer in view
+   "patch FILE" applies a unified diff.  Each hunk is first tried where
+   its header puts it, shifted by the offset the hunks before it were
+   found at.  Otherwise the buffer's lines, hashed once into a table,
+   are searched for the rarest line of the hunk's old text and only the
+   places it occurs are compared, so a moved hunk is found in O(1) on
+   average instead of by scanning.  As with patch(1), up to two context
+   lines at either end may be ignored (fuzz) when the full context does
+   not match.  The hunks that apply are then made in a single pass over
+   the buffer; the others are reported on the status line.
+
+   "diff" shows the buffer against its file on disk, removed lines in
+   red with a '-', added ones in green with a '+'.  Every line is hashed
+   to 64 bits once and equal hashes share a class number, so the diff
+   itself only compares integers.  Lines that only one side has are set
+   aside first, since they cannot be in common, and the rest goes
+   through Myers' O((N+M)D) search.  When a part costs too many edits it
+   is split at a line that occurs once on each side (patience anchors),
+   so moved blocks stay cheap, or failing that at GNU diff's guess.  The
+   view lasts until the next command; the arrows scroll it.
+*/
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stddef.h>   /* for size_t */
+#include <stdint.h>
+
+uint64_t line_hash(const char *s, size_t len);
+
+int patch_apply(const char *path);      /* 0 if every hunk applied */
+
+/* Lines of a and b outside their common subsequence: sets del[i] for
+   each such line of a and ins[j] for each of b.  -1 if out of memory. */
+int diff_hashes(const uint64_t *a, size_t n, const uint64_t *b, size_t m,
+                char *del, char *ins);
+
+/*--------------------------------------------------------------------
+  Diff view, called by draw_buffer / run_editor in place of the buffer
+ --------------------------------------------------------------------*/
+int  diff_open(void);               /* 0 on success, also when no changes */
+int  diff_active(void);
+void diff_close(void);
+void diff_draw(size_t rows, int cols);  /* rows of text from the top of the view,
+                                           clipped to cols from scroll_col on */
+size_t diff_widest(size_t rows);    /* columns of the widest row in view */
+void diff_scroll(int dir);          /* one row, -1 or +1 */
+
+#endif /* DIFF_H */
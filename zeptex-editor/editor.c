@@ -1,4 +1,17 @@
 #include "editor.h"
+#include "buffer.h"
+#include "diff.h"
+#include "edits.h"
+#include "follow.h"
+#include "highlight.h"
+#include "input.h"
+#include "pager.h"
+#include "reload.h"
+#include "search.h"
+#include "stats.h"
+#include "stream.h"
+#include "trace.h"
+#include "trigram.h"
 
 #include <signal.h>
 #include <stdio.h>
@@ -8,17 +21,35 @@
 #include <termios.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <time.h>
 
-#define MAX_LINES 1000
-#define MAX_LINE_LEN 1024
-
-char *lines[MAX_LINES];
+static char *first_lines[MAX_LINES];
+char **lines = first_lines;     // switched by buffer.c
 size_t line_count = 0;
 size_t scroll_offset = 0;
+size_t scroll_col = 0;
+int scroll_pin_bottom = 0;
+size_t last_max_scroll = 0;
+int buffer_dirty = 0;
 
 struct termios orig_termios;
 
-volatile sig_atomic_t resize_flag = 0;  // flag set by SIGWINCH handler
+int resize_flag = 0;            // set_window_size() or SIGWINCH changed the size
+static int winch_fd = -1;       // signalfd for SIGWINCH, -1 when serving
+static int stop_fd = -1;        // readable when the server is to stop
+
+struct winsize window_override;         // size sent in-band by a client
+
+char status_msg[256] = "";  // shown in the blank row above the command bar
+
+static size_t edit_gen;     // bumped by every change to the buffer's lines
+
+static void wrap_line_inserted(size_t index);
+static void wrap_line_deleted(size_t index);
+static void wrap_edits_applied(const zx_edit *edits, size_t n);
 
 // Terminal raw mode handling
 
@@ -42,50 +73,83 @@ void enable_raw_mode() {
 
 // Window resize handling
 
-// Handle window resize signal
-void handle_resize(int sig) {
-    (void)sig;
+// Terminal size, as sent by the client when serving over a socket
+void get_window_size(struct winsize *w) {
+    if (window_override.ws_row) *w = window_override;
+    else if (ioctl(STDOUT_FILENO, TIOCGWINSZ, w) == -1) memset(w, 0, sizeof(*w));
+}
+
+// Use a fixed size instead of asking the terminal (0 rows to stop)
+void set_window_size(int rows, int cols) {
+    window_override.ws_row = (unsigned short)rows;
+    window_override.ws_col = (unsigned short)cols;
     resize_flag = 1;
 }
 
-// Set up window resize signal handler
+// Block SIGWINCH and receive it through a signalfd polled by run_editor;
+// called before any thread starts, as threads inherit the blocked mask
 void setup_sigwinch_handler() {
-    struct sigaction sa = {
-        .sa_handler = handle_resize,
-        .sa_flags = 0
-    };
-    sigemptyset(&sa.sa_mask);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGWINCH);
 
-    if (sigaction(SIGWINCH, &sa, NULL) == -1) {
-        perror("sigaction");
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1 ||
+        (winch_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1) {
+        perror("signalfd");
         exit(1);
     }
 }
 
+static int winch_get(void) {
+    return winch_fd;
+}
+
+static int winch_update(void) {
+    struct signalfd_siginfo si;
+    while (read(winch_fd, &si, sizeof(si)) == sizeof(si))
+        ;
+    resize_flag = 1;
+    return 0;               // redrawn with any other resize
+}
+
 // File operations
 
 // Load file content into editor buffer
 void load_file(const char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (!f) return;
+    struct stream *s = stream_open(filename, STREAM_READ);
+    if (!s) return;
 
-    char buf[MAX_LINE_LEN];
-    while (fgets(buf, sizeof(buf), f)) {
-        if (line_count >= MAX_LINES) break;
-        buf[strcspn(buf, "\n")] = 0;
-        lines[line_count++] = strdup(buf);
+    char *line;
+    size_t len, bytes = 0;
+    uint64_t t = TRACE_BEGIN();
+    stats_io_start();
+    while (line_count < MAX_LINES && (line = stream_getline(s, &len))) {
+        lines[line_count++] = line;
+        bytes += len + 1;
     }
-    fclose(f);
+    stream_close(s);
+    edit_gen++;
+    stats_io_end(0, bytes);
+    TRACE_END(t, "load");
 }
 
 // Save editor content to file
 void save_file(const char *filename) {
-    FILE *f = fopen(filename, "w");
-    if (!f) return;
+    struct stream *s = stream_open(filename, STREAM_WRITE);
+    if (!s) return;
 
-    for (size_t i = 0; i < line_count; ++i)
-        fprintf(f, "%s\n", lines[i]);
-    fclose(f);
+    size_t bytes = 0;
+    uint64_t t = TRACE_BEGIN();
+    stats_io_start();
+    for (size_t i = 0; i < line_count; ++i) {
+        size_t len = strlen(lines[i]);
+        stream_write(s, lines[i], len);
+        stream_write(s, "\n", 1);
+        bytes += len + 1;
+    }
+    stream_close(s);
+    stats_io_end(1, bytes);
+    TRACE_END(t, "save");
 }
 
 // Buffer operations
@@ -93,128 +157,827 @@ void save_file(const char *filename) {
 // Insert a new line at specified index
 void insert_line(size_t index, const char *text) {
     if (line_count >= MAX_LINES || index == 0 || index > line_count + 1) return;
+    uint64_t t = TRACE_BEGIN();
     for (size_t i = line_count; i >= index; --i)
         lines[i] = lines[i - 1];
     lines[index - 1] = strdup(text);
     line_count++;
+    buffer_dirty = 1;
+    edit_gen++;
+    stats_edit(1);
+    wrap_line_inserted(index - 1);
+    hl_line_inserted(index - 1);
+    tri_line_inserted(index - 1);
+    search_buffer_changed();
+    TRACE_END(t, "edit");
 }
 
 // Delete line at specified index
 void delete_line(size_t index) {
     if (index == 0 || index > line_count) return;
+    uint64_t t = TRACE_BEGIN();
+    tri_line_deleting(index - 1);
     free(lines[index - 1]);
     for (size_t i = index - 1; i < line_count - 1; ++i)
         lines[i] = lines[i + 1];
     line_count--;
+    buffer_dirty = 1;
+    edit_gen++;
+    stats_edit(1);
+    wrap_line_deleted(index - 1);
     if (scroll_offset > 0 && scroll_offset >= line_count)
         scroll_offset = line_count ? line_count - 1 : 0;
+    hl_line_deleted(index - 1);
+    search_buffer_changed();
+    TRACE_END(t, "edit");
+}
+
+// Apply edits, checked as for zx_apply() (edits.h), in one pass over
+// the buffer; the caches are updated once, from the first line touched
+int apply_edits(const zx_edit *edits, size_t n) {
+    uint64_t t = TRACE_BEGIN();
+    size_t inserts, deletes;
+    if (edits_check(edits, n, line_count, &inserts, &deletes) < 0) return -1;
+    size_t count = line_count + inserts - deletes;
+    if (count > MAX_LINES) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    char **out = malloc((count ? count : 1) * sizeof(char *));
+    char **copies = out ? edits_copy(edits, n, inserts) : NULL;
+    if (!copies) {
+        free(out);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    tri_edits_deleting(edits, n);   // its builder reads the lines freed below
+
+    size_t from = 0, to = 0, c = 0;
+    for (size_t k = 0; k < n; ++k) {
+        size_t at = edits[k].index;
+        while (from < at) out[to++] = lines[from++];
+        if (edits[k].op == ZX_INSERT) out[to++] = copies[c++];
+        else free(lines[from++]);
+    }
+    while (from < line_count) out[to++] = lines[from++];
+    memcpy(lines, out, count * sizeof(char *));
+    line_count = count;
+    free(copies);
+    free(out);
+
+    buffer_dirty = 1;
+    edit_gen++;
+    stats_edit(n);
+    wrap_edits_applied(edits, n);
+    hl_edits_applied(edits, n);
+    tri_edits_applied(edits, n);
+    search_buffer_changed();
+    TRACE_END(t, "edit");
+    return 0;
 }
 
 // Display functions
 
+// Set the status message shown until the next command
+void set_status(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(status_msg, sizeof(status_msg), fmt, ap);
+    va_end(ap);
+}
+
+// Columns of a UTF-8 string: continuation bytes take none
+static int text_cols(const char *s) {
+    int n = 0;
+    for (; *s; ++s) n += (*s & 0xC0) != 0x80;
+    return n;
+}
+
+// The status row, without its newline
+static void draw_status(int width) {
+    const char *status = status_msg[0] || !pager_active() ? status_msg : pager_position();
+    printf("%.*s", width > 0 ? width : 0, status);
+}
+
 // Draw command bar with editor commands
 void draw_command_bar() {
     struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+    get_window_size(&w);
     int width = w.ws_col;
 
-    const char *cmds[] = {
+    const char *edit_cmds[] = {
         "i N TEXT -- insert line|",
         "d N -- delete line|",
         "↑/↓ scroll|",
+        "/text or /{a|b} -- search, n/N|",
         "w <filename> -- save|",
         "q -- Quit|"
     };
-    int cmd_count = sizeof(cmds) / sizeof(cmds[0]);
+    const char *pager_cmds[] = {
+        "↑/↓ scroll|",
+        "%N -- jump to N%|",
+        "g N -- go to line|",
+        "q -- Quit|"
+    };
+    const char **cmds = pager_active() ? pager_cmds : edit_cmds;
+    int cmd_count = pager_active() ? sizeof(pager_cmds) / sizeof(pager_cmds[0])
+                                   : sizeof(edit_cmds) / sizeof(edit_cmds[0]);
 
     int total_cmd_len = 0;
     for (int i = 0; i < cmd_count; i++)
-        total_cmd_len += strlen(cmds[i]);
+        total_cmd_len += text_cols(cmds[i]);
 
     int total_spaces = width - total_cmd_len;
     int gap = total_spaces > 0 ? total_spaces / (cmd_count - 1) : 1;
 
+    draw_status(width);
     printf("\n");
+    int used = 0;                   // commands that do not fit are left off, not wrapped
     for (int i = 0; i < cmd_count; i++) {
+        int len = text_cols(cmds[i]);
+        if (used + len > width) break;
         printf("\033[1;97m%s\033[0m", cmds[i]);
-        if (i < cmd_count - 1)
+        used += len;
+        if (i < cmd_count - 1 && used + gap <= width) {
             printf("%*s", gap, "");
+            used += gap;
+        }
     }
     printf("\n");
 }
 
-// Draw main editor buffer with title and content
-void draw_buffer() {
-    printf("\033[H\033[J");
+// Column index
+//
+// Lines are drawn clipped to the columns in view, scroll_col onwards.
+// A tab takes the columns up to the next multiple of 8, a control byte
+// or a stray UTF-8 byte shows as ? and any other character as one
+// column.  Finding the byte where a column starts takes no work for
+// printable ASCII lines; other lines get checkpoints every COL_STEP
+// columns, cached by line until the next edit, so scrolling far into a
+// long line costs the same as its first screen.
+
+#define COL_STEP 64         // columns between checkpoints
+#define COL_CACHE 256       // lines indexed at once, by line index
+#define HSCROLL_STEP 8      // columns per left/right arrow
+
+struct col_stop {
+    size_t byte, col;       // the character covering column k * COL_STEP
+};
+
+static struct col_index {
+    const char *text;       // the line indexed, NULL for none
+    size_t gen;             // edit_gen when indexed
+    size_t bytes, width;    // width in columns
+    int ascii;              // printable ASCII only: byte = column
+    struct col_stop *stops;
+} col_cache[COL_CACHE];
+
+// Columns of the character at s, which starts at column col; *len gets
+// its bytes, of the avail there are
+static size_t char_cols_in(const char *s, size_t avail, size_t col, size_t *len) {
+    unsigned char c = (unsigned char)*s;
+    *len = 1;
+    if (c == '\t') return 8 - col % 8;
+    if (c < 0xC0 || c > 0xF4) return 1;     // ASCII, control or stray byte
+    size_t n = c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+    size_t k = 1;
+    while (k < n && k < avail && ((unsigned char)s[k] & 0xC0) == 0x80) k++;
+    if (k == n) *len = n;
+    return 1;
+}
+
+// The same in a NUL-terminated string, where the NUL ends a character
+static size_t char_cols(const char *s, size_t col, size_t *len) {
+    return char_cols_in(s, (size_t)-1, col, len);
+}
+
+static const struct col_index *col_index(size_t index) {
+    struct col_index *ci = &col_cache[index % COL_CACHE];
+    const char *text = lines[index];
+    if (ci->text == text && ci->gen == edit_gen) return ci;
 
+    ci->text = text;
+    ci->gen = edit_gen;
+    ci->ascii = 1;
+    size_t col = 0, len, cap = 0, count = 0;
+    int indexing = 1;           // until out of memory; col_seek then walks
+    size_t i = 0;
+    for (; text[i]; i += len) {
+        unsigned char c = (unsigned char)text[i];
+        if (c < 32 || c >= 127) ci->ascii = 0;
+        size_t w = char_cols(text + i, col, &len);
+        while (indexing && col + w > count * COL_STEP) {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 16;
+                struct col_stop *grown = realloc(ci->stops, cap * sizeof(*grown));
+                if (!grown) {
+                    indexing = 0;
+                    break;
+                }
+                ci->stops = grown;
+            }
+            ci->stops[count++] = (struct col_stop){ i, col };
+        }
+        col += w;
+    }
+    ci->bytes = i;
+    ci->width = col;
+    if (ci->ascii || !indexing) {
+        free(ci->stops);
+        ci->stops = NULL;
+    }
+    return ci;
+}
+
+// The character covering column col: its byte and starting column
+static void col_seek(size_t index, size_t col, size_t *byte, size_t *at) {
+    const struct col_index *ci = col_index(index);
+    *at = col;
+    if (col >= ci->width) *byte = ci->bytes;
+    else if (ci->ascii) *byte = col;
+    if (col >= ci->width || ci->ascii) return;
+
+    size_t i = 0, c = 0, len;
+    if (ci->stops) {
+        i = ci->stops[col / COL_STEP].byte;
+        c = ci->stops[col / COL_STEP].col;
+    }
+    for (size_t w; c + (w = char_cols(lines[index] + i, c, &len)) <= col; i += len) c += w;
+    *byte = i;
+    *at = c;
+}
+
+// Widest of the lines from first on, for how far right to scroll
+static size_t widest_line(size_t first, size_t count) {
+    size_t widest = 0;
+    for (size_t i = first; i < first + count && i < line_count; ++i) {
+        size_t w = col_index(i)->width;
+        if (w > widest) widest = w;
+    }
+    return widest;
+}
+
+// Left arrow (D), or right (C) while a line in view goes on
+static void hscroll(int final, size_t widest) {
+    if (final == 'D') scroll_col = scroll_col > HSCROLL_STEP ? scroll_col - HSCROLL_STEP : 0;
+    else if (final == 'C' && scroll_col + HSCROLL_STEP < widest) scroll_col += HSCROLL_STEP;
+}
+
+// Print the columns [first, first + width) of text[0, end), from the
+// character at byte i and column col that covers first, coloured by attrs
+static void draw_cols(const char *text, size_t end, const unsigned char *attrs,
+                      size_t i, size_t col, size_t first, size_t width) {
+    unsigned char cls = HL_NORMAL;
+    size_t shown = 0, run = i, len;     // run: first byte not yet written
+    for (; i < end && shown < width; i += len) {
+        size_t w = char_cols_in(text + i, end - i, col, &len);
+        unsigned char c = (unsigned char)text[i];
+        int plain = c >= 32 && c != 127 && (c < 0x80 || len > 1);
+        if (plain && shown + w > width) break;
+        if ((attrs && attrs[i] != cls) || !plain) {
+            fwrite(text + run, 1, i - run, stdout);
+            run = plain ? i : i + len;
+        }
+        if (attrs && attrs[i] != cls) {
+            cls = attrs[i];
+            printf("\033[%sm", hl_color(cls));
+        }
+
+        size_t cols = w;
+        if (c == '\t') {
+            // A tab cut by either edge shows only its columns in view
+            if (col < first) cols -= first - col;
+            if (cols > width - shown) cols = width - shown;
+            printf("%*s", (int)cols, "");
+        } else if (!plain) {
+            putchar('?');
+        }
+        shown += cols;
+        col += w;
+    }
+    fwrite(text + run, 1, i - run, stdout);
+    if (cls != HL_NORMAL) printf("\033[0m");
+}
+
+// One buffer line, coloured by the active highlighter
+static void draw_line(size_t index, size_t first, size_t width) {
+    size_t i, col;
+    col_seek(index, first, &i, &col);
+    draw_cols(lines[index], col_index(index)->bytes, hl_line_attrs(index), i, col, first, width);
+}
+
+// Text that is not a buffer line (the diff and pager views), uncoloured
+void draw_text(const char *text, size_t len, size_t first, size_t width) {
+    size_t i = 0, col = 0, n;
+    for (size_t w; i < len && col + (w = char_cols_in(text + i, len - i, col, &n)) <= first; i += n)
+        col += w;
+    draw_cols(text, len, NULL, i, col, first, width);
+}
+
+size_t text_width(const char *text, size_t len) {
+    size_t col = 0, n;
+    for (size_t i = 0; i < len; i += n) col += char_cols_in(text + i, len - i, col, &n);
+    return col;
+}
+
+// One text row: the line with its number, or ~ past the end
+static void draw_row(size_t line_index, int cols) {
+    if (line_index < line_count) {
+        int prefix = printf("%3zu | ", line_index + 1);
+        if (cols > prefix) draw_line(line_index, scroll_col, (size_t)(cols - prefix));
+    } else {
+        printf("~");
+    }
+}
+
+// Soft wrap
+//
+// With wrap on, a line takes as many rows as its width needs and the
+// view scrolls by rows: its top is a line and a row within it
+// (scroll_offset, wrap_top.sub).  The width of each line is kept, and
+// insert_line, delete_line and apply_edits measure only the lines they
+// add.  A Fenwick tree over the rows per line gives the first row of a
+// line and the line holding a row in O(log n); after an edit only the
+// tree nodes from the first changed line on are summed again, and only
+// a new text width re-sums them all.  So a frame costs the same wherever
+// it is in the buffer, and an appended line (follow mode) O(log n).
+
+static int wrap_on;
+
+static struct {
+    char **lines;               // the buffer indexed, NULL for none
+    size_t gen, count;          // edit_gen and line_count it is up to date with
+    size_t width;               // text columns per row
+    size_t rows;                // rows of the whole buffer
+    size_t stale;               // tree nodes past this line need summing again
+    size_t cap;                 // slots in cols; tree has one more
+    size_t *cols;               // width of each line
+    size_t *tree;               // Fenwick tree of rows per line, 1-based
+} wrap;
+
+static struct {
+    char **lines;
+    size_t line, sub;           // sub is the top row while line is scroll_offset
+} wrap_top;
+
+static size_t text_cols_of(const char *text) {
+    size_t col = 0, len;
+    for (; *text; text += len) col += char_cols(text, col, &len);
+    return col;
+}
+
+static size_t line_rows(size_t index) {
+    return wrap.cols[index] ? (wrap.cols[index] + wrap.width - 1) / wrap.width : 1;
+}
+
+// Rows of the lines before line index
+static size_t rows_before(size_t index) {
+    size_t rows = 0;
+    for (size_t i = index; i; i &= i - 1) rows += wrap.tree[i];
+    return rows;
+}
+
+// The line holding row and, in *sub, the row within it; line_count past the end
+static size_t line_at_row(size_t row, size_t *sub) {
+    size_t line = 0, step = 1;
+    while (step * 2 <= wrap.count) step *= 2;
+    for (; step; step /= 2) {
+        if (line + step <= wrap.count && wrap.tree[line + step] <= row) {
+            line += step;
+            row -= wrap.tree[line];
+        }
+    }
+    *sub = row;
+    return line;
+}
+
+// Line number prefix "NNN | ", as wide for every line so rows wrap alike
+static int number_cols(void) {
+    return snprintf(NULL, 0, "%3zu | ", line_count);
+}
+
+static int wrap_reserve(size_t count) {
+    if (count <= wrap.cap) return 0;
+    size_t cap = wrap.cap ? wrap.cap : 1024;
+    while (cap < count) cap *= 2;
+    size_t *cols = realloc(wrap.cols, cap * sizeof(*cols));
+    if (!cols) return -1;
+    wrap.cols = cols;
+    size_t *tree = realloc(wrap.tree, (cap + 1) * sizeof(*tree));
+    if (!tree) return -1;
+    wrap.tree = tree;
+    wrap.cap = cap;
+    return 0;
+}
+
+// Whether the index was up to date before the edit just made, which
+// changed line_count by delta; if not, it is measured again when used
+static int wrap_follows(long delta) {
+    if (wrap.lines == lines && wrap.gen + 1 == edit_gen &&
+        (long)wrap.count + delta == (long)line_count && wrap_reserve(line_count) == 0)
+        return 1;
+    wrap.lines = NULL;
+    return 0;
+}
+
+// Lines from index on moved or changed
+static void wrap_changed_from(size_t index) {
+    if (index < wrap.stale) wrap.stale = index;
+    wrap.gen = edit_gen;
+    wrap.count = line_count;
+}
+
+static void wrap_line_inserted(size_t index) {
+    if (!wrap_follows(1)) return;
+    memmove(wrap.cols + index + 1, wrap.cols + index, (wrap.count - index) * sizeof(size_t));
+    wrap.cols[index] = text_cols_of(lines[index]);
+    wrap_changed_from(index);
+}
+
+static void wrap_line_deleted(size_t index) {
+    if (!wrap_follows(-1)) return;
+    memmove(wrap.cols + index, wrap.cols + index + 1, (line_count - index) * sizeof(size_t));
+    wrap_changed_from(index);
+}
+
+// The same merge as apply_edits, over the widths
+static void wrap_edits_applied(const zx_edit *edits, size_t n) {
+    if (!n) return;
+    size_t inserts = 0;
+    for (size_t k = 0; k < n; ++k) inserts += edits[k].op == ZX_INSERT;
+    size_t *out;
+    if (!wrap_follows((long)inserts - (long)(n - inserts)) ||
+        !(out = malloc((line_count ? line_count : 1) * sizeof(*out)))) {
+        wrap.lines = NULL;
+        return;
+    }
+    size_t from = 0, to = 0;
+    for (size_t k = 0; k < n; ++k) {
+        while (from < edits[k].index) out[to++] = wrap.cols[from++];
+        if (edits[k].op == ZX_INSERT) {
+            out[to] = text_cols_of(lines[to]);
+            to++;
+        } else {
+            from++;
+        }
+    }
+    while (to < line_count) out[to++] = wrap.cols[from++];
+    memcpy(wrap.cols, out, line_count * sizeof(*out));
+    free(out);
+    wrap_changed_from(edits[0].index);
+}
+
+// Bring the index up to date for a terminal cols wide
+static int wrap_index(int cols) {
+    size_t width = cols > number_cols() ? (size_t)(cols - number_cols()) : 1;
+    if (wrap.lines != lines || wrap.gen != edit_gen || wrap.count != line_count) {
+        // Another buffer, or loaded since: measure every line
+        if (wrap_reserve(line_count) < 0) return -1;
+        for (size_t i = 0; i < line_count; ++i) wrap.cols[i] = text_cols_of(lines[i]);
+        wrap.lines = lines;
+        wrap.gen = edit_gen;
+        wrap.count = line_count;
+        wrap.stale = 0;
+    }
+    if (wrap.width != width) {
+        wrap.width = width;
+        wrap.stale = 0;
+    }
+
+    // Node i sums lines (i - lowbit(i), i]: its own and the nodes under it
+    for (size_t i = wrap.stale + 1; i <= wrap.count; ++i) {
+        size_t sum = line_rows(i - 1);
+        for (size_t j = i - 1; j > i - (i & -i); j &= j - 1) sum += wrap.tree[j];
+        wrap.tree[i] = sum;
+    }
+    wrap.stale = wrap.count;
+    wrap.rows = rows_before(wrap.count);
+    return 0;
+}
+
+// Rows of the buffer on a terminal cols wide: one per line unless wrapping
+static size_t view_rows(int cols) {
+    if (wrap_on && wrap_index(cols) < 0) {
+        wrap_on = 0;
+        set_status("Wrap off: out of memory");
+    }
+    return wrap_on ? wrap.rows : line_count;
+}
+
+// The row at the top of the view (after view_rows() for the same width)
+static size_t view_top(void) {
+    if (!wrap_on) return scroll_offset;
+    if (scroll_offset >= line_count) return wrap.rows;
+    size_t sub = wrap_top.lines == lines && wrap_top.line == scroll_offset ? wrap_top.sub : 0;
+    if (sub >= line_rows(scroll_offset)) sub = line_rows(scroll_offset) - 1;
+    return rows_before(scroll_offset) + sub;
+}
+
+static void view_set_top(size_t row) {
+    if (!wrap_on) {
+        scroll_offset = row;
+        return;
+    }
+    scroll_offset = line_at_row(row, &wrap_top.sub);
+    wrap_top.lines = lines;
+    wrap_top.line = scroll_offset;
+}
+
+// One row of the view: a line, or with wrap on a piece of one
+static void draw_view_row(size_t row, int cols) {
+    if (!wrap_on) {
+        draw_row(row, cols);
+        return;
+    }
+    size_t sub, index = line_at_row(row, &sub);
+    if (index >= line_count) {
+        printf("~");
+        return;
+    }
+    int digits = number_cols() - 3;
+    if (sub) printf("%*s | ", digits, "");
+    else printf("%*zu | ", digits, index + 1);
+    draw_line(index, sub * wrap.width, wrap.width);
+}
+
+// "wrap [on|off]", toggling without an argument
+static void wrap_command(const char *arg) {
+    char word[8] = "";
+    sscanf(arg, "%7s", word);
+    if (!word[0]) wrap_on = !wrap_on;
+    else if (strcmp(word, "on") == 0) wrap_on = 1;
+    else if (strcmp(word, "off") == 0) wrap_on = 0;
+    else {
+        set_status("Use: wrap [on|off]");
+        return;
+    }
+    wrap_top.lines = NULL;
+    if (!wrap_on) wrap.lines = NULL;    // not kept up to date while off
+    if (scroll_offset >= last_max_scroll) scroll_pin_bottom = 1;   // stay at the end
+    set_status("Wrap %s", wrap_on ? "on" : "off");
+}
+
+// What the text frame on screen shows, so that a scroll can move it
+static struct {
+    int valid;
+    char **lines;
+    size_t gen, count, top, col;    // top in rows of view_rows()
+    int wrap;
+    unsigned short rows, cols;
+    const struct highlighter *hl;
+} on_screen;
+
+// When nothing but the top row changed since the last text frame,
+// shift the text rows inside a scroll region (DECSTBM) and draw just the
+// rows that came into view, then the overlay, the status and a cleared
+// prompt row; 0 if a full frame is needed.  Rows 1-2 are the title and
+// overlay, then the text, the status, the command bar and the prompt.
+static int scroll_frame(const struct winsize *w, size_t usable_rows) {
+    if (!on_screen.valid || on_screen.lines != lines || on_screen.gen != edit_gen ||
+        on_screen.count != line_count || on_screen.col != scroll_col ||
+        on_screen.wrap != wrap_on || on_screen.rows != w->ws_row ||
+        on_screen.cols != w->ws_col || on_screen.hl != hl_current() ||
+        w->ws_row <= 5)
+        return 0;
+    size_t view = view_top();
+    long d = (long)view - (long)on_screen.top;
+    if (labs(d) >= (long)usable_rows) return 0;
+
+    int top = 3, bottom = 2 + (int)usable_rows;
+    if (d) printf("\033[%d;%dr", top, bottom);
+    if (d > 0) {
+        printf("\033[%d;1H", bottom);
+        for (long k = 0; k < d; ++k) printf("\n");          // text moves up
+    } else if (d < 0) {
+        printf("\033[%d;1H", top);
+        for (long k = 0; k < -d; ++k) printf("\033M");      // reverse index: down
+    }
+    if (d) printf("\033[r");
+
+    size_t first = d > 0 ? usable_rows - (size_t)d : 0, count = (size_t)labs(d);
+    for (size_t i = first; i < first + count; ++i) {
+        printf("\033[%zu;1H", (size_t)top + i);
+        draw_view_row(view + i, w->ws_col);
+    }
+    printf("\033[2;1H\033[K");
+    stats_overlay(w->ws_col);
+    printf("\033[%d;1H\033[K", bottom + 1);
+    draw_status(w->ws_col);
+    printf("\033[%d;1H\033[K", w->ws_row);
+    on_screen.top = view;
+    return 1;
+}
+
+// Draw main editor buffer with title and content
+static void draw_frame(void) {
     struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+    get_window_size(&w);
+    size_t usable_rows = (w.ws_row > 5) ? (w.ws_row - 5) : 1;
+
+    int text = !pager_active() && !diff_active();
+    if (text) {
+        size_t rows = view_rows(w.ws_col), sub;
+        size_t max_scroll = (rows > usable_rows) ? (rows - usable_rows) : 0;
+        if (view_top() > max_scroll || scroll_pin_bottom) view_set_top(max_scroll);
+        scroll_pin_bottom = 0;
+        last_max_scroll = wrap_on ? line_at_row(max_scroll, &sub) : max_scroll;
+        if (scroll_frame(&w, usable_rows)) return;
+    }
+    on_screen.valid = 0;
+
+    printf("\033[H\033[J");
 
     const char *title = "ZEPTEX EDITOR version 1.0";
     int padding = (w.ws_col - (int)strlen(title)) / 2;
     if (padding < 0) padding = 0;
 
-    printf("%*s\033[1;97m%s\033[0m\n\n", padding > 0 ? padding : 0, "", title);
-
-    size_t usable_rows = (w.ws_row > 5) ? (w.ws_row - 5) : 1;
+    printf("%*s\033[1;97m%s\033[0m\n", padding > 0 ? padding : 0, "", title);
+    stats_overlay(w.ws_col);
+    printf("\n");
 
-    size_t max_scroll = (line_count > usable_rows) ? (line_count - usable_rows) : 0;
-    if (scroll_offset > max_scroll) scroll_offset = max_scroll;
+    if (pager_active()) {
+        pager_draw(usable_rows, w.ws_col);
+        draw_command_bar();
+        return;
+    }
+    if (diff_active()) {
+        diff_draw(usable_rows, w.ws_col);
+        draw_command_bar();
+        return;
+    }
 
+    size_t top = view_top();
     for (size_t i = 0; i < usable_rows; ++i) {
-        size_t line_index = i + scroll_offset;
-        if (line_index < line_count) {
-            printf("%3zu | %s\n", line_index + 1, lines[line_index]);
-        } else {
-            printf("~\n");
-        }
+        draw_view_row(top + i, w.ws_col);
+        printf("\n");
     }
 
     draw_command_bar();
+    on_screen.valid = 1;
+    on_screen.lines = lines;
+    on_screen.gen = edit_gen;
+    on_screen.count = line_count;
+    on_screen.top = top;
+    on_screen.col = scroll_col;
+    on_screen.wrap = wrap_on;
+    on_screen.rows = w.ws_row;
+    on_screen.cols = w.ws_col;
+    on_screen.hl = hl_current();
+}
+
+void draw_buffer(void) {
+    stats_frame_start();
+    uint64_t t = TRACE_BEGIN();
+    draw_frame();
+    TRACE_END(t, "render");
+    t = TRACE_BEGIN();
     fflush(stdout);
+    TRACE_END(t, "flush");
+    stats_frame_end();
 }
 
 
 
 
 // Main editor loop
-void run_editor(const char *filename) {
-    char cmd[MAX_LINE_LEN] = {0};
-    size_t cmd_len = 0;
 
+// What run_editor waits on besides the keys: an fd (-1 while unused)
+// and its handler, which returns 1 when the screen needs redrawing
+static const struct source {
+    int (*fd)(void);
+    int (*update)(void);
+} sources[] = {
+    { winch_get, winch_update },
+    { follow_fd, follow_update },
+    { reload_fd, reload_update },
+    { pager_fd, pager_update },
+};
+
+#define SOURCES (sizeof(sources) / sizeof(sources[0]))
+
+// Frames are scheduled rather than drawn: redraw() marks the screen out
+// of date and next_key() draws once no input is waiting, so a burst of
+// input (a paste, a held key) costs one frame.  While input keeps coming,
+// a frame is still drawn every 1/frame_cap seconds.
+static unsigned frame_cap = 60;     // frames per second; 0: one per input
+static int frame_pending;
+static uint64_t frame_at;           // ns, when the last frame was drawn
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+void set_frame_cap(unsigned fps) {
+    frame_cap = fps;
+}
+
+void set_stop_fd(int fd) {
+    stop_fd = fd;
+}
+
+static void redraw(void) {
+    if (frame_pending) stats_frame_skipped();
+    frame_pending = 1;
+}
+
+// Draw the screen and the command typed so far
+static void draw_pending(const char *cmd) {
     draw_buffer();
-    printf(": ");
+    printf(": %s", cmd);
     fflush(stdout);
-    
-    while (1) {
+    frame_pending = 0;
+    frame_at = now_ns();
+}
+
+static int frame_due(void) {
+    return !frame_cap || now_ns() - frame_at >= 1000000000u / frame_cap;
+}
+
+// Wait for the next key, handling resizes, the sources and pending
+// frames meanwhile; returns 1 with the key in *c, or 0 at the end of input
+static ssize_t next_key(char *c, const char *cmd) {
+    for (;;) {
         if (resize_flag) {
-            draw_buffer();
-            printf(": %s", cmd);
-            fflush(stdout);
             resize_flag = 0;
+            on_screen.valid = 0;
+            input_resized();
+            redraw();
         }
 
+        // With a frame pending, only look at what is already there
+        struct pollfd pfd[SOURCES + 2] = { { .fd = input_fd(), .events = POLLIN } };
+        for (size_t i = 0; i < SOURCES; ++i)
+            pfd[i + 1] = (struct pollfd){ .fd = sources[i].fd(), .events = POLLIN };
+        pfd[SOURCES + 1] = (struct pollfd){ .fd = stop_fd, .events = POLLIN };
+        if (poll(pfd, SOURCES + 2, frame_pending ? 0 : -1) == -1) continue;     // EINTR
+        if (pfd[SOURCES + 1].revents & POLLIN) return 0;    // left for the server to read
+
+        for (size_t i = 0; i < SOURCES; ++i)
+            if ((pfd[i + 1].revents & POLLIN) && sources[i].update()) redraw();
+        int key = pfd[0].revents & (POLLIN | POLLHUP | POLLERR);
+        if (frame_pending && (!key || frame_due())) draw_pending(cmd);
+        if (!key) continue;
+
+        ssize_t n = input_read(c);
+        if (n >= 0) return n;
+        if (errno != EINTR && errno != EAGAIN) return 0;   // the terminal is gone
+    }
+}
+
+void run_editor(void) {
+    char cmd[MAX_LINE_LEN] = {0};
+    size_t cmd_len = 0;
+
+    on_screen.valid = 0;        // a new client's screen is blank
+    redraw();
+
+    while (1) {
         char c;
-        ssize_t n = read(STDIN_FILENO, &c, 1);
-        if (n == -1) {
-            if (errno == EINTR) {
-                if (resize_flag) {
-                    draw_buffer();
-                    printf(": %s", cmd);
-                    fflush(stdout);
-                    resize_flag = 0;
-                }
-                continue;
-            }
-            continue;
-        }
-        if (n == 0) continue;
+        if (next_key(&c, cmd) == 0) break;      // end of input (client went away)
 
         if (c == '\r' || c == '\n') {
             cmd[cmd_len] = '\0';
 
             if (strcmp(cmd, "q") == 0) break;
 
+            uint64_t t = TRACE_BEGIN();
+            status_msg[0] = '\0';
+            int diffing = diff_active();
+            diff_close();               // any command leaves the diff view
+            if (pager_active()) {
+                pager_command(cmd);
+            } else if (cmd[0] == '/') {
+                search_run(cmd + 1);
+            } else if (cmd[0] == '?') {
+                search_run_regex(cmd + 1);
+            } else if (strcmp(cmd, "n") == 0) {
+                search_jump(1);
+            } else if (strcmp(cmd, "N") == 0) {
+                search_jump(-1);
+            } else if (follow_fd() >= 0 && (cmd[0] == 'e' || cmd[0] == 'b')) {
+                set_status("Only one buffer in follow mode");
+            } else if (cmd[0] == 'e') {
+                char fname[256];
+                if (sscanf(cmd, "e %255s", fname) == 1) buffer_open(fname);
+            } else if (strcmp(cmd, "bn") == 0 || strcmp(cmd, "bp") == 0) {
+                buffer_cycle(cmd[1] == 'n' ? 1 : -1);
+            } else if (strncmp(cmd, "stats", 5) == 0 && (cmd[5] == '\0' || cmd[5] == ' ')) {
+                stats_command(cmd + 5);
+            } else if (strncmp(cmd, "trace", 5) == 0 && (cmd[5] == '\0' || cmd[5] == ' ')) {
+                trace_command(cmd + 5);
+            } else if (strncmp(cmd, "wrap", 4) == 0 && (cmd[4] == '\0' || cmd[4] == ' ')) {
+                wrap_command(cmd + 4);
+            } else if (strncmp(cmd, "patch ", 6) == 0) {
+                patch_apply(cmd + 6);
+            }
+            else if (strcmp(cmd, "diff") == 0) {
+                if (!diffing) diff_open();
+            }
+
             else if (cmd[0] == 'i') {
                 int line_no = 0;
                 char *p = cmd + 1; // points after 'i'
@@ -222,9 +985,7 @@ void run_editor(const char *filename) {
                 // Check for exactly one space after 'i'
                 if (*p != ' ') {
                     // invalid: no space immediately after 'i'
-                    draw_buffer();
-                    printf(": Invalid insert syntax. Use: i <line> <text>\n");
-                    fflush(stdout);
+                    set_status("Invalid insert syntax. Use: i <line> <text>");
                     goto after_command;
                 }
                 p++; // move past that one space
@@ -235,9 +996,7 @@ void run_editor(const char *filename) {
                 char *space_after_lineno = strchr(p, ' ');
                 if (!space_after_lineno) {
                     // no space after lineno → no input text → invalid
-                    draw_buffer();
-                    printf(": Invalid insert syntax. Use: i <line> <text>\n");
-                    fflush(stdout);
+                    set_status("Invalid insert syntax. Use: i <line> <text>");
                     goto after_command;
                 }
                 
@@ -247,9 +1006,7 @@ void run_editor(const char *filename) {
                 *space_after_lineno = ' '; // restore
                 
                 if (line_no <= 0) {
-                    draw_buffer();
-                    printf(": Invalid line number. Use: i <line> <text>\n");
-                    fflush(stdout);
+                    set_status("Invalid line number. Use: i <line> <text>");
                     goto after_command;
                 }
                 
@@ -259,7 +1016,7 @@ void run_editor(const char *filename) {
                 insert_line((size_t)line_no, input_text);
                 
                 struct winsize w;
-                ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+                get_window_size(&w);
                 size_t screen_lines = (w.ws_row > 3) ? (w.ws_row - 3) : 1;
             
                 if ((size_t)line_no > scroll_offset + screen_lines)
@@ -279,9 +1036,7 @@ void run_editor(const char *filename) {
             
                 // Check for exactly one space after 'a'
                 if (*p != ' ') {
-                    draw_buffer();
-                    printf(": Invalid append syntax. Use: a <text>\n");
-                    fflush(stdout);
+                    set_status("Invalid append syntax. Use: a <text>");
                     goto after_command_a;
                 }
                 p++; // move past that one space
@@ -290,9 +1045,7 @@ void run_editor(const char *filename) {
                 char *input_text = p;
             
                 if (*input_text == '\0') {
-                    draw_buffer();
-                    printf(": No text to append. Use: a <text>\n");
-                    fflush(stdout);
+                    set_status("No text to append. Use: a <text>");
                     goto after_command_a;
                 }
             
@@ -300,7 +1053,7 @@ void run_editor(const char *filename) {
                 insert_line(line_count + 1, input_text);
             
                 struct winsize w;
-                ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+                get_window_size(&w);
                 size_t screen_lines = (w.ws_row > 3) ? (w.ws_row - 3) : 1;
             
                 if (line_count > scroll_offset + screen_lines)
@@ -320,35 +1073,59 @@ void run_editor(const char *filename) {
                     delete_line((size_t)line_no);
             } else if (cmd[0] == 'w') {
                 char fname[256];
-                if (sscanf(cmd, "w %255s", fname) == 1)
-                    save_file(fname);
-                else if (filename)
-                    save_file(filename);
+                const char *filename = buffer_name();
+                const char *target = sscanf(cmd, "w %255s", fname) == 1 ? fname : filename;
+                if (target) save_file(target);
+                if (target && filename && strcmp(target, filename) == 0) {
+                    buffer_dirty = 0;
+                    reload_resync();        // our own write is not a change
+                }
             }
+            TRACE_END(t, "command");
 
             cmd_len = 0;
             cmd[0] = '\0';
-            draw_buffer();
-            printf(": ");
-            fflush(stdout);
+            redraw();
             continue;
         } else if (c == 127 || c == '\b') {  // Backspace
             if (cmd_len > 0) cmd[--cmd_len] = '\0';
         } else if (c == '\033') {
-            char seq[2];
-            if (read(STDIN_FILENO, &seq[0], 1) != 1) continue;
-            if (read(STDIN_FILENO, &seq[1], 1) != 1) continue;
+            // CSI: ESC [ parameters final-byte
+            char seq[32] = "";
+            size_t len = 0;
+            if (input_read(&seq[0]) != 1 || seq[0] != '[') continue;
+            do {
+                if (input_read(&seq[len]) != 1) break;
+            } while ((seq[len] < 0x40 || seq[len] > 0x7e) && ++len < sizeof(seq) - 1);
+            char final = seq[len];
+            seq[len] = '\0';
 
-            if (seq[0] == '[') {
+            int rows, cols;
+            if (final == 't' && sscanf(seq, "8;%d;%d", &rows, &cols) == 2) {
+                set_window_size(rows, cols);   // resize from a client
+                continue;
+            }
+            if (len == 0) {
                 struct winsize w;
-                ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-                size_t screen_lines = (w.ws_row > 3) ? (w.ws_row - 3) : 1;
-                size_t max_scroll = (line_count > screen_lines) ? (line_count - screen_lines) : 0;
+                get_window_size(&w);
+                size_t screen_lines = (w.ws_row > 5) ? (w.ws_row - 5) : 1;
+                size_t rows = view_rows(w.ws_col);
+                size_t max_scroll = (rows > screen_lines) ? (rows - screen_lines) : 0;
+                size_t top = view_top();
 
-                if (seq[1] == 'A') {  // Up arrow
-                    if (scroll_offset > 0) scroll_offset--;
-                } else if (seq[1] == 'B') {  // Down arrow
-                    if (scroll_offset < max_scroll) scroll_offset++;
+                if (pager_active()) {
+                    if (final == 'A' || final == 'B') pager_scroll(final == 'A' ? -1 : 1);
+                } else if (diff_active()) {
+                    if (final == 'A' || final == 'B') diff_scroll(final == 'A' ? -1 : 1);
+                    else hscroll(final, diff_widest(screen_lines));
+                } else if (final == 'A') {  // Up arrow, a row when wrapping
+                    if (top > 0) view_set_top(top - 1);
+                } else if (final == 'B') {  // Down arrow
+                    if (top < max_scroll) view_set_top(top + 1);
+                } else if (wrap_on) {
+                    // Lines wrap: nothing off to the side
+                } else {
+                    hscroll(final, widest_line(scroll_offset, screen_lines));
                 }
             }
         } else if (cmd_len < MAX_LINE_LEN - 1 && c >= 32 && c < 127) {
@@ -356,35 +1133,6 @@ void run_editor(const char *filename) {
             cmd[cmd_len] = '\0';
         }
 
-        draw_buffer();
-        printf(": %s", cmd);
-        fflush(stdout);
+        redraw();
     }
 }
-
-// ========== MAIN ==========
-
-int main(int argc, char **argv) {
-    const char *filename = NULL;
-    if (argc > 1) filename = argv[1];
-
-    // Alt screen & cursor off
-    printf("\033[?1049h\033[?25l");
-
-    enable_raw_mode();
-
-    setup_sigwinch_handler();
-
-    if (filename) load_file(filename);
-
-    run_editor(filename);
-
-    disable_raw_mode();
-
-    // Restore screen
-    printf("\033[?1049l\033[?25h");
-
-    for (size_t i = 0; i < line_count; ++i) free(lines[i]);
-
-    return 0;
-}
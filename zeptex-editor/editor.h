@@ -14,6 +14,8 @@
 
 #include <stddef.h>   /* for size_t */
 
+#include "zeptex.h"   /* zx_edit */
+
 /*--------------------------------------------------------------------
   Compile-time limits
   (guarded so we do not complain if already defined elsewhere)
@@ -28,10 +30,25 @@
 
 
 /*--------------------------------------------------------------------
-  Global text buffer (very small editor = very small global state)
+  Global text buffer (very small editor = very small global state);
+  always the buffer in view, see buffer.h for the others
  --------------------------------------------------------------------*/
-extern char *lines[MAX_LINES];   /* dynamically allocated lines       */
+extern char **lines;             /* MAX_LINES slots, allocated lines  */
 extern size_t line_count;        /* number of active lines in buffer  */
+extern size_t scroll_offset;     /* first buffer line shown on screen */
+extern size_t scroll_col;        /* first text column shown on screen */
+extern int scroll_pin_bottom;    /* next draw scrolls to the last line */
+extern size_t last_max_scroll;   /* bottom scroll_offset at last draw  */
+extern int buffer_dirty;         /* edited since the last load or save */
+
+/*--------------------------------------------------------------------
+  Terminal setup
+ --------------------------------------------------------------------*/
+void enable_raw_mode(void);
+void disable_raw_mode(void);
+void setup_sigwinch_handler(void);
+void get_window_size(struct winsize *w);
+void set_window_size(int rows, int cols);   /* override, for --server */
 
 /*--------------------------------------------------------------------
   File I/O helpers
@@ -44,11 +61,21 @@ void save_file(const char *filename);
  --------------------------------------------------------------------*/
 void insert_line(size_t index, const char *text);   /* 1-based index */
 void delete_line(size_t index);                     /* 1-based index */
+int  apply_edits(const zx_edit *edits, size_t n);   /* as zx_apply() */
 
 /*--------------------------------------------------------------------
   UI helpers
  --------------------------------------------------------------------*/
 void draw_buffer(void);
-void run_editor(const char *filename);
+void run_editor(void);
+void set_frame_cap(unsigned fps);       /* frames/s during bursts of input */
+void set_stop_fd(int fd);               /* run_editor returns once readable */
+void set_status(const char *fmt, ...);  /* one-line message above the bar */
+
+/* Columns [first, first + width) of len bytes of text, laid out as the
+   buffer is: tabs to the next multiple of 8, one column per UTF-8
+   character, ? for a control byte */
+void   draw_text(const char *text, size_t len, size_t first, size_t width);
+size_t text_width(const char *text, size_t len);
 
 #endif /* editor_H */
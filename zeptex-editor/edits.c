@@ -0,0 +1,49 @@
+#include "edits.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+int edits_check(const zx_edit *edits, size_t n, size_t count,
+                size_t *inserts, size_t *deletes) {
+    *inserts = *deletes = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const zx_edit *e = &edits[k];
+        int bad = (k && e->index < edits[k - 1].index) || e->index > count;
+        if (e->op == ZX_DELETE) {
+            bad |= e->index == count;
+            for (size_t j = k; j-- > 0 && edits[j].index == e->index;)
+                bad |= edits[j].op == ZX_DELETE;
+            ++*deletes;
+        } else if (e->op == ZX_INSERT) {
+            ++*inserts;
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+char **edits_copy(const zx_edit *edits, size_t n, size_t inserts) {
+    char **copies = malloc((inserts ? inserts : 1) * sizeof(char *));
+    size_t made = 0;
+    for (size_t k = 0; copies && k < n; ++k) {
+        if (edits[k].op != ZX_INSERT) continue;
+        char *copy = malloc(edits[k].len + 1);
+        if (!copy) break;
+        memcpy(copy, edits[k].text, edits[k].len);
+        copy[edits[k].len] = '\0';
+        copies[made++] = copy;
+    }
+    if (!copies || made < inserts) {
+        while (made) free(copies[--made]);
+        free(copies);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return copies;
+}
@@ -0,0 +1,23 @@
+/* edits.h - the batch contract of zx_apply, shared with apply_edits
+   libzeptex and the editor both apply a sorted batch of zx_edit in one
+   merge pass; the checks a batch must pass and the copies of its
+   inserted text made before anything changes live here, once.
+*/
+#ifndef EDITS_H
+#define EDITS_H
+
+#include <stddef.h>   /* for size_t */
+
+#include "zeptex.h"   /* zx_edit */
+
+/* 0 if the batch is valid for a buffer of count lines, with its inserts
+   and deletes counted; -1 with errno EINVAL if indices decrease, go past
+   the end, delete a line twice or an op is unknown. */
+int edits_check(const zx_edit *edits, size_t n, size_t count,
+                size_t *inserts, size_t *deletes);
+
+/* The inserted texts in batch order, NUL-terminated, in an array of
+   inserts (caller frees both); NULL with errno ENOMEM, nothing left over. */
+char **edits_copy(const zx_edit *edits, size_t n, size_t inserts);
+
+#endif /* EDITS_H */
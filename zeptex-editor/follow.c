@@ -0,0 +1,167 @@
+#include "editor.h"
+#include "follow.h"
+#include "watch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FOLLOW_CHUNK 65536
+
+static struct {
+    struct file_watch w;
+    int fd;                 // followed file, -1 while it is missing
+    off_t offset;           // bytes of the file already in the buffer
+    char *pend;             // unterminated last line
+    size_t pend_len, pend_cap;
+    int pend_shown;         // pend is the last buffer line
+    int at_bottom;          // view was on the last line before the update
+} fw = { { NULL, -1, -1, -1, 0 }, -1, 0, NULL, 0, 0, 0, 0 };
+
+// Buffer side
+
+static void follow_append(const char *text, int complete) {
+    if (fw.pend_shown) {
+        delete_line(line_count);
+        fw.pend_shown = 0;
+    }
+    if (line_count >= MAX_LINES) {
+        delete_line(1);
+        if (!fw.at_bottom && scroll_offset > 0) scroll_offset--;
+    }
+    insert_line(line_count + 1, text);
+    fw.pend_shown = !complete;
+}
+
+// The file starts over (truncated or replaced): its unterminated last
+// line stays in the buffer as a finished line, and reading begins again
+static void follow_restart(void) {
+    if (fw.pend_len && !fw.pend_shown) follow_append(fw.pend, 1);
+    fw.pend_len = 0;
+    fw.pend_shown = 0;
+    fw.offset = 0;
+}
+
+static int pend_add(const char *bytes, size_t n) {
+    if (fw.pend_len + n + 1 > fw.pend_cap) {
+        size_t cap = fw.pend_cap ? fw.pend_cap : 256;
+        while (cap < fw.pend_len + n + 1) cap *= 2;
+        char *grown = realloc(fw.pend, cap);
+        if (!grown) return -1;
+        fw.pend = grown;
+        fw.pend_cap = cap;
+    }
+    memcpy(fw.pend + fw.pend_len, bytes, n);
+    fw.pend_len += n;
+    fw.pend[fw.pend_len] = '\0';
+    return 0;
+}
+
+// Read everything past fw.offset, returns 1 if any byte arrived
+static int follow_read(void) {
+    char buf[FOLLOW_CHUNK];
+    int changed = 0;
+    for (;;) {
+        ssize_t n = pread(fw.fd, buf, sizeof(buf), fw.offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        fw.offset += n;
+        changed = 1;
+
+        const char *p = buf, *end = buf + n;
+        for (const char *nl; (nl = memchr(p, '\n', (size_t)(end - p))); p = nl + 1) {
+            if (pend_add(p, (size_t)(nl - p)) < 0) return changed;
+            follow_append(fw.pend, 1);
+            fw.pend_len = 0;
+        }
+        if (pend_add(p, (size_t)(end - p)) < 0) return changed;
+    }
+    if (changed && fw.pend_len) follow_append(fw.pend, 0);
+    return changed;
+}
+
+// Offset where the last MAX_LINES lines of the file start
+static off_t tail_start(int fd, off_t size) {
+    char buf[FOLLOW_CHUNK];
+    size_t newlines = 0;
+    off_t pos = size;
+    while (pos > 0) {
+        size_t n = pos > (off_t)sizeof(buf) ? sizeof(buf) : (size_t)pos;
+        pos -= (off_t)n;
+        if (pread(fd, buf, n, pos) != (ssize_t)n) return 0;
+        for (size_t i = n; i-- > 0;) {
+            if (buf[i] != '\n' || pos + (off_t)i == size - 1) continue;
+            if (++newlines == MAX_LINES) return pos + (off_t)i + 1;
+        }
+    }
+    return 0;
+}
+
+// Watches
+
+static int open_followed(void) {
+    fw.fd = open(fw.w.path, O_RDONLY);
+    follow_restart();
+    return fw.fd < 0 ? -1 : 0;
+}
+
+int follow_start(const char *filename) {
+    follow_stop();
+    if (watch_open(&fw.w, filename, IN_MODIFY | IN_ATTRIB) < 0 || open_followed() < 0) {
+        follow_stop();
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fw.fd, &st) == 0) fw.offset = tail_start(fw.fd, st.st_size);
+    fw.at_bottom = 1;
+    follow_read();
+    scroll_pin_bottom = 1;
+    return 0;
+}
+
+int follow_fd(void) {
+    return fw.w.ino;
+}
+
+int follow_update(void) {
+    int events = watch_poll(&fw.w);
+    if (!events) return 0;
+
+    fw.at_bottom = scroll_offset >= last_max_scroll;
+    int changed = 0;
+    if (fw.fd >= 0) {
+        struct stat st;
+        if (fstat(fw.fd, &st) == 0 && st.st_size < fw.offset) {
+            follow_restart();   // truncated in place (copytruncate)
+            set_status("%s: file truncated", fw.w.path);
+        }
+        changed |= follow_read();
+    }
+    if (events & WATCH_REPLACED) {
+        // Old file is finished, continue with whatever has the name now
+        if (fw.fd >= 0) close(fw.fd);
+        fw.fd = -1;
+        if (watch_rearm(&fw.w) == 0 && open_followed() == 0) {
+            set_status("%s: following new file", fw.w.path);
+            changed |= follow_read();
+        }
+    }
+
+    if (changed && fw.at_bottom) scroll_pin_bottom = 1;
+    return changed;
+}
+
+void follow_stop(void) {
+    if (fw.fd >= 0) close(fw.fd);
+    watch_close(&fw.w);
+    free(fw.pend);
+    fw.fd = -1;
+    fw.pend = NULL;
+    fw.pend_len = fw.pend_cap = 0;
+    fw.pend_shown = 0;
+}
@@ -0,0 +1,15 @@
+/* follow.h - "tail -f" mode for growing files
+   The last MAX_LINES lines of the file are loaded, then the file is
+   watched with inotify and only appended bytes are read and turned
+   into buffer lines.  Once the buffer is full the oldest lines are
+   dropped.  Truncation and rename/recreate rotation are followed too.
+*/
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+int  follow_start(const char *filename);  /* 0 on success, -1 on error   */
+int  follow_fd(void);                     /* fd to poll, -1 if inactive  */
+int  follow_update(void);                 /* 1 when the buffer changed   */
+void follow_stop(void);
+
+#endif /* FOLLOW_H */
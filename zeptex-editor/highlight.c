@@ -0,0 +1,427 @@
+#include "editor.h"
+#include "highlight.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HL_CLEAN SIZE_MAX   // dirty_from when every cached state is valid
+
+size_t hl_lexed_lines = 0;
+
+static const struct highlighter *hl_active = NULL;
+static int *eol;            // end-of-line state per line, -1 = unknown
+static size_t eol_cap;
+static size_t dirty_from = HL_CLEAN;    // first line whose state may be stale
+static size_t force_end;    // lines below this changed and must be re-lexed
+static unsigned char *attr_buf;
+static size_t attr_cap;
+
+// Lexer helpers
+
+static void mark(unsigned char *attrs, size_t from, size_t to, int cls) {
+    if (attrs && to > from) memset(attrs + from, cls, to - from);
+}
+
+static int is_ident(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int in_list(const char *const *list, const char *word, size_t len) {
+    for (; *list; ++list)
+        if (strncmp(*list, word, len) == 0 && (*list)[len] == '\0') return 1;
+    return 0;
+}
+
+// C highlighter
+
+enum { C_CODE = 0, C_BLOCK_COMMENT = 1 };
+
+static const char *const c_keywords[] = {
+    "auto", "break", "case", "const", "continue", "default", "do", "else",
+    "enum", "extern", "for", "goto", "if", "inline", "register", "restrict",
+    "return", "sizeof", "static", "struct", "switch", "typedef", "union",
+    "volatile", "while", NULL
+};
+
+static const char *const c_types[] = {
+    "void", "char", "short", "int", "long", "float", "double", "signed",
+    "unsigned", "_Bool", "bool", "size_t", "ssize_t", "int8_t", "int16_t",
+    "int32_t", "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t",
+    "FILE", NULL
+};
+
+static int lex_c(const struct highlighter *h, const char *line, int state,
+                 unsigned char *attrs) {
+    (void)h;
+    size_t i = 0;
+
+    // Preprocessor directive word: "#include", "# define", ...
+    while (line[i] == ' ' || line[i] == '\t') i++;
+    if (state == C_CODE && line[i] == '#') {
+        size_t j = i + 1;
+        while (line[j] == ' ' || line[j] == '\t') j++;
+        while (is_ident(line[j])) j++;
+        mark(attrs, 0, i, HL_NORMAL);
+        mark(attrs, i, j, HL_PREPROC);
+        i = j;
+    } else {
+        mark(attrs, 0, i, state == C_BLOCK_COMMENT ? HL_COMMENT : HL_NORMAL);
+    }
+
+    while (line[i]) {
+        if (state == C_BLOCK_COMMENT) {
+            const char *end = strstr(line + i, "*/");
+            size_t j = end ? (size_t)(end - line) + 2 : i + strlen(line + i);
+            mark(attrs, i, j, HL_COMMENT);
+            i = j;
+            if (end) state = C_CODE;
+            continue;
+        }
+
+        char c = line[i];
+        if (c == '/' && line[i + 1] == '/') {
+            mark(attrs, i, i + strlen(line + i), HL_COMMENT);
+            break;
+        } else if (c == '/' && line[i + 1] == '*') {
+            mark(attrs, i, i + 2, HL_COMMENT);
+            i += 2;
+            state = C_BLOCK_COMMENT;
+        } else if (c == '"' || c == '\'') {
+            size_t j = i + 1;
+            while (line[j] && line[j] != c) j += (line[j] == '\\' && line[j + 1]) ? 2 : 1;
+            if (line[j]) j++;
+            mark(attrs, i, j, HL_STRING);
+            i = j;
+        } else if (is_ident(c) && (i == 0 || !is_ident(line[i - 1]))) {
+            size_t j = i;
+            while (is_ident(line[j]) || (is_digit(c) && line[j] == '.')) j++;
+            int cls = HL_NORMAL;
+            if (is_digit(c)) cls = HL_NUMBER;
+            else if (in_list(c_keywords, line + i, j - i)) cls = HL_KEYWORD;
+            else if (in_list(c_types, line + i, j - i)) cls = HL_TYPE;
+            mark(attrs, i, j, cls);
+            i = j;
+        } else {
+            mark(attrs, i, i + 1, HL_NORMAL);
+            i++;
+        }
+    }
+    return state;
+}
+
+static const char *const c_extensions[] = { ".c", ".h", NULL };
+
+const struct highlighter hl_c = { "C", c_extensions, lex_c, NULL };
+
+// Log highlighter
+//
+// Records look like "2024-05-01T12:00:00.123Z ERROR [component] text".
+// The state is the level of the current record, so indented
+// continuation lines (stack traces, wrapped payloads) keep its colour.
+
+enum { LOG_NONE = 0, LOG_ERROR, LOG_WARN, LOG_INFO, LOG_DEBUG };
+
+static const char *const log_error[] = { "ERROR", "ERR", "FATAL", "CRIT", "CRITICAL", "PANIC", NULL };
+static const char *const log_warn[] = { "WARN", "WARNING", NULL };
+static const char *const log_info[] = { "INFO", "NOTICE", NULL };
+static const char *const log_debug[] = { "DEBUG", "TRACE", NULL };
+
+static int log_level_class(int level) {
+    switch (level) {
+    case LOG_ERROR: return HL_ERROR;
+    case LOG_WARN:  return HL_WARN;
+    case LOG_INFO:  return HL_INFO;
+    case LOG_DEBUG: return HL_DEBUG;
+    }
+    return HL_NORMAL;
+}
+
+static int lex_log(const struct highlighter *h, const char *line, int state,
+                   unsigned char *attrs) {
+    (void)h;
+    size_t len = strlen(line);
+
+    // Continuation of the previous record
+    if (line[0] == ' ' || line[0] == '\t') {
+        int cls = state == LOG_ERROR || state == LOG_WARN ? log_level_class(state) : HL_NORMAL;
+        mark(attrs, 0, len, cls);
+        return state;
+    }
+
+    size_t i = 0;
+    if (is_digit(line[0])) {
+        // Date and time: digits and separators, a space only between digits
+        for (;; ++i) {
+            char c = line[i];
+            if (is_digit(c) || (c && strchr("-:.,/TZ+", c))) continue;
+            if (c == ' ' && is_digit(line[i + 1])) continue;
+            break;
+        }
+        mark(attrs, 0, i, HL_TIME);
+    }
+
+    int level = LOG_NONE;
+    while (line[i]) {
+        char c = line[i];
+        if (c == '[') {
+            const char *end = strchr(line + i, ']');
+            size_t j = end ? (size_t)(end - line) + 1 : len;
+            mark(attrs, i, j, HL_KEYWORD);
+            i = j;
+        } else if (c == '"') {
+            size_t j = i + 1;
+            while (line[j] && line[j] != '"') j += (line[j] == '\\' && line[j + 1]) ? 2 : 1;
+            if (line[j]) j++;
+            mark(attrs, i, j, HL_STRING);
+            i = j;
+        } else if (is_ident(c) && (i == 0 || !is_ident(line[i - 1]))) {
+            size_t j = i;
+            while (is_ident(line[j])) j++;
+            int cls = HL_NORMAL;
+            if (is_digit(c)) {
+                cls = HL_NUMBER;
+            } else if (level == LOG_NONE) {
+                if (in_list(log_error, line + i, j - i)) level = LOG_ERROR;
+                else if (in_list(log_warn, line + i, j - i)) level = LOG_WARN;
+                else if (in_list(log_info, line + i, j - i)) level = LOG_INFO;
+                else if (in_list(log_debug, line + i, j - i)) level = LOG_DEBUG;
+                if (level != LOG_NONE) cls = log_level_class(level);
+            }
+            mark(attrs, i, j, cls);
+            i = j;
+        } else {
+            mark(attrs, i, i + 1, HL_NORMAL);
+            i++;
+        }
+    }
+    return level;
+}
+
+static const char *const log_extensions[] = { ".log", NULL };
+
+const struct highlighter hl_log = { "log", log_extensions, lex_log, NULL };
+
+// State cache
+
+static const struct highlighter *const hl_builtin[] = { &hl_c, &hl_log, NULL };
+
+static const struct highlighter **hl_user;
+static size_t hl_user_count;
+
+int hl_register(const struct highlighter *h) {
+    const struct highlighter **grown = realloc(hl_user, (hl_user_count + 1) * sizeof(*grown));
+    if (!grown) return -1;
+    hl_user = grown;
+    hl_user[hl_user_count++] = h;
+    return 0;
+}
+
+static int hl_reserve(size_t n) {
+    if (n <= eol_cap) return 0;
+    size_t cap = eol_cap ? eol_cap : 1024;
+    while (cap < n) cap *= 2;
+    int *grown = realloc(eol, cap * sizeof(int));
+    if (!grown) return -1;
+    eol = grown;
+    eol_cap = cap;
+    return 0;
+}
+
+void hl_set(const struct highlighter *h) {
+    hl_active = h;
+    if (h && hl_reserve(line_count) < 0) hl_active = NULL;
+    if (!hl_active) return;
+    for (size_t i = 0; i < line_count; ++i) eol[i] = -1;
+    dirty_from = line_count ? 0 : HL_CLEAN;
+    force_end = 0;
+}
+
+// Pick a highlighter by file extension, or sniff a timestamped log
+void hl_select(const char *filename) {
+    const char *dot = filename ? strrchr(filename, '.') : NULL;
+    for (size_t h = hl_user_count; dot && h > 0; --h) {
+        if (in_list(hl_user[h - 1]->extensions, dot, strlen(dot))) {
+            hl_set(hl_user[h - 1]);
+            return;
+        }
+    }
+    for (size_t h = 0; dot && hl_builtin[h]; ++h) {
+        if (in_list(hl_builtin[h]->extensions, dot, strlen(dot))) {
+            hl_set(hl_builtin[h]);
+            return;
+        }
+    }
+    if (line_count && is_digit(lines[0][0]) && is_digit(lines[0][1]) &&
+        is_digit(lines[0][2]) && is_digit(lines[0][3]) && lines[0][4] == '-') {
+        hl_set(&hl_log);
+        return;
+    }
+    hl_set(NULL);
+}
+
+const struct highlighter *hl_current(void) {
+    return hl_active;
+}
+
+// Re-lex the first stale line; stop once its end state matches the cache
+static void hl_step(unsigned char *attrs) {
+    size_t i = dirty_from;
+    int st = hl_active->lex(hl_active, lines[i], i ? eol[i - 1] : 0, attrs);
+    hl_lexed_lines++;
+    int converged = i >= force_end && st == eol[i];
+    eol[i] = st;
+    if (converged || i + 1 >= line_count) {
+        dirty_from = HL_CLEAN;
+        force_end = 0;
+    } else {
+        dirty_from = i + 1;
+    }
+}
+
+void hl_line_inserted(size_t index) {
+    if (!hl_active) return;
+    if (hl_reserve(line_count) < 0) {
+        hl_active = NULL;
+        return;
+    }
+    memmove(eol + index + 1, eol + index, (line_count - 1 - index) * sizeof(int));
+    eol[index] = -1;
+    if (dirty_from == HL_CLEAN) {
+        dirty_from = index;
+        force_end = index + 1;
+    } else {
+        if (force_end > index) force_end++;
+        if (force_end < index + 1) force_end = index + 1;
+        if (dirty_from > index) dirty_from = index;
+    }
+}
+
+void hl_line_deleted(size_t index) {
+    if (!hl_active) return;
+    memmove(eol + index, eol + index + 1, (line_count - index) * sizeof(int));
+    if (force_end > index) force_end--;
+    if (force_end < index) force_end = index;
+    if (dirty_from == HL_CLEAN || dirty_from > index) dirty_from = index;
+    if (dirty_from >= line_count) {
+        dirty_from = HL_CLEAN;
+        force_end = 0;
+    }
+}
+
+// apply_edits made a batch of edits: the cached states past them move
+// with their lines, and lexing resumes at the first line touched
+void hl_edits_applied(const zx_edit *edits, size_t n) {
+    if (!hl_active || !n) return;
+    int *out = malloc((line_count ? line_count : 1) * sizeof(int));
+    if (!out || hl_reserve(line_count) < 0) {
+        free(out);
+        hl_set(hl_active);
+        return;
+    }
+    size_t from = 0, to = 0;
+    for (size_t k = 0; k < n; ++k) {
+        while (from < edits[k].index) out[to++] = eol[from++];
+        if (edits[k].op == ZX_INSERT) out[to++] = -1;
+        else from++;
+    }
+    size_t end = to, old_end = from;    // lines from here on are unchanged
+    while (to < line_count) out[to++] = eol[from++];
+    memcpy(eol, out, line_count * sizeof(int));
+    free(out);
+
+    size_t first = edits[0].index;
+    if (dirty_from == HL_CLEAN) {
+        dirty_from = first;
+        force_end = end;
+    } else {
+        if (force_end > old_end) force_end = force_end - old_end + end;
+        if (force_end < end) force_end = end;
+        if (dirty_from > first) dirty_from = first;
+    }
+    if (dirty_from >= line_count) {
+        dirty_from = HL_CLEAN;
+        force_end = 0;
+    }
+}
+
+const unsigned char *hl_line_attrs(size_t index) {
+    if (!hl_active || index >= line_count) return NULL;
+
+    size_t len = strlen(lines[index]);
+    if (len + 1 > attr_cap) {
+        unsigned char *grown = realloc(attr_buf, len + 1);
+        if (!grown) return NULL;
+        attr_buf = grown;
+        attr_cap = len + 1;
+    }
+
+    while (dirty_from < index) hl_step(NULL);
+    if (dirty_from == index) {
+        hl_step(attr_buf);
+    } else {
+        hl_active->lex(hl_active, lines[index], index ? eol[index - 1] : 0, attr_buf);
+        hl_lexed_lines++;
+    }
+    return attr_buf;
+}
+
+// Per-buffer state
+
+struct hl_cache {
+    const struct highlighter *active;
+    int *eol;
+    size_t eol_cap, dirty_from, force_end;
+};
+
+void *hl_park(void) {
+    struct hl_cache *saved = malloc(sizeof(*saved));
+    if (saved) {
+        *saved = (struct hl_cache){ hl_active, eol, eol_cap, dirty_from, force_end };
+    } else {
+        free(eol);          // out of memory: the buffer comes back plain
+    }
+    hl_active = NULL;
+    eol = NULL;
+    eol_cap = 0;
+    dirty_from = HL_CLEAN;
+    force_end = 0;
+    return saved;
+}
+
+void hl_unpark(void *state) {
+    struct hl_cache c = { NULL, NULL, 0, HL_CLEAN, 0 };
+    if (state) {
+        c = *(struct hl_cache *)state;
+        free(state);
+    }
+    free(eol);
+    hl_active = c.active;
+    eol = c.eol;
+    eol_cap = c.eol_cap;
+    dirty_from = c.dirty_from;
+    force_end = c.force_end;
+}
+
+const char *hl_color(unsigned char cls) {
+    static const char *const colors[HL_CLASS_COUNT] = {
+        [HL_NORMAL]  = "0",
+        [HL_KEYWORD] = "1;34",
+        [HL_TYPE]    = "36",
+        [HL_STRING]  = "32",
+        [HL_COMMENT] = "90",
+        [HL_NUMBER]  = "35",
+        [HL_PREPROC] = "33",
+        [HL_TIME]    = "36",
+        [HL_ERROR]   = "1;31",
+        [HL_WARN]    = "33",
+        [HL_INFO]    = "32",
+        [HL_DEBUG]   = "90",
+    };
+    return cls < HL_CLASS_COUNT ? colors[cls] : colors[HL_NORMAL];
+}
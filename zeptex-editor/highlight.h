@@ -0,0 +1,78 @@
+/* highlight.h - syntax highlighting with an incremental state cache
+   A highlighter lexes one line at a time: it receives the lexer state
+   at the start of the line and returns the state at its end.  Those
+   end-of-line states are cached per line, so after an edit only the
+   lines from the edit point until the state converges are lexed again,
+   and only lines that are about to be drawn get their attributes.
+*/
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <stddef.h>   /* for size_t */
+
+#include "zeptex.h"   /* zx_edit */
+
+/*--------------------------------------------------------------------
+  Highlight classes, one per byte of a line
+ --------------------------------------------------------------------*/
+enum hl_class {
+    HL_NORMAL = 0,
+    HL_KEYWORD,
+    HL_TYPE,
+    HL_STRING,
+    HL_COMMENT,
+    HL_NUMBER,
+    HL_PREPROC,
+    HL_TIME,
+    HL_ERROR,
+    HL_WARN,
+    HL_INFO,
+    HL_DEBUG,
+    HL_CLASS_COUNT
+};
+
+/*--------------------------------------------------------------------
+  Highlighter definition
+  lex() fills attrs (when not NULL) with one hl_class per byte of line
+  and returns the end-of-line state; state 0 is the start of a file.
+ --------------------------------------------------------------------*/
+struct highlighter {
+    const char *name;
+    const char *const *extensions;      /* NULL-terminated, e.g. ".c" */
+    int (*lex)(const struct highlighter *h, const char *line, int state,
+               unsigned char *attrs);
+    const void *ctx;                    /* private to lex()           */
+};
+
+extern const struct highlighter hl_c;
+extern const struct highlighter hl_log;
+
+/* User highlighters (e.g. compiled syntax files) take precedence over
+   the built-in ones when a file extension matches */
+int hl_register(const struct highlighter *h);
+
+/*--------------------------------------------------------------------
+  Buffer state cache
+ --------------------------------------------------------------------*/
+void hl_select(const char *filename);               /* by name/content */
+void hl_set(const struct highlighter *h);           /* NULL = plain    */
+const struct highlighter *hl_current(void);
+
+void hl_line_inserted(size_t index);                /* 0-based index   */
+void hl_line_deleted(size_t index);
+void hl_edits_applied(const zx_edit *edits, size_t n);  /* apply_edits  */
+
+/* Per-buffer state (buffer.c): the cache leaves with its buffer, so a
+   buffer shown again is not re-lexed */
+void *hl_park(void);
+void hl_unpark(void *state);
+
+/* Attributes of lines[index] (valid until the next call), or NULL when
+   no highlighter is active */
+const unsigned char *hl_line_attrs(size_t index);
+const char *hl_color(unsigned char cls);            /* SGR parameters  */
+
+/* Lines lexed since start-up, for measuring re-highlight cost */
+extern size_t hl_lexed_lines;
+
+#endif /* HIGHLIGHT_H */
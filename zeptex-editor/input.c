@@ -0,0 +1,184 @@
+#include "editor.h"
+#include "input.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SLOWEST 5           // steps listed after a replay
+#define HELD_MAX 32         // bytes of an escape sequence held back, as run_editor reads
+
+struct step {
+    uint64_t ns;            // editor time for this byte
+    uint64_t at;            // when it was typed, us into the recording
+    size_t index;
+    unsigned char c;
+};
+
+static struct {
+    FILE *log;
+    int replaying;
+    uint64_t start;         // ns, when recording began
+    uint64_t handed;        // ns, when the replay gave out a byte; 0 = none
+    struct step *steps;
+    size_t count, cap;
+    struct step next;       // the byte given out
+    unsigned char held[HELD_MAX];   // escape sequence not logged yet
+    uint64_t held_us[HELD_MAX];
+    size_t held_len;
+} in;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Replay
+
+static void note_step(uint64_t ns) {
+    if (in.count == in.cap) {
+        size_t cap = in.cap ? in.cap * 2 : 1024;
+        struct step *grown = realloc(in.steps, cap * sizeof(struct step));
+        if (!grown) return;
+        in.steps = grown;
+        in.cap = cap;
+    }
+    in.next.ns = ns;
+    in.steps[in.count++] = in.next;
+}
+
+static ssize_t replay_read(char *c) {
+    if (in.handed) note_step(now_ns() - in.handed);
+    in.handed = 0;
+
+    unsigned long long us;
+    unsigned byte;
+    char kind;
+    int rows, cols;
+    if (fscanf(in.log, "%llu %c", &us, &kind) != 2) return 0;      // end of the log
+    if (kind == 'r') {
+        if (fscanf(in.log, "%d %d", &rows, &cols) != 2) return 0;
+        set_window_size(rows, cols);
+        errno = EINTR;      // no byte; run_editor redraws at the new size
+        return -1;
+    }
+    if (kind != 'k' || fscanf(in.log, "%x", &byte) != 1) return 0;
+
+    *c = (char)byte;
+    in.next.at = us;
+    in.next.index = in.count;
+    in.next.c = (unsigned char)byte;
+    in.handed = now_ns();
+    return 1;
+}
+
+static int by_time(const void *a, const void *b) {
+    uint64_t x = ((const struct step *)a)->ns, y = ((const struct step *)b)->ns;
+    return x < y ? 1 : x > y ? -1 : 0;      // slowest first
+}
+
+static void replay_report(void) {
+    if (!in.count) return;
+    uint64_t total = 0;
+    for (size_t i = 0; i < in.count; ++i) total += in.steps[i].ns;
+    qsort(in.steps, in.count, sizeof(struct step), by_time);
+
+    fprintf(stderr, "replay: %zu keys in %.1f ms; per key p50 %.1f us, p99 %.1f us, max %.1f us\n",
+            in.count, total / 1e6, in.steps[in.count / 2].ns / 1e3,
+            in.steps[in.count / 100].ns / 1e3, in.steps[0].ns / 1e3);
+    for (size_t i = 0; i < in.count && i < SLOWEST; ++i) {
+        const struct step *s = &in.steps[i];
+        char shown[8];
+        if (s->c >= 32 && s->c < 127) snprintf(shown, sizeof(shown), "'%c'", s->c);
+        else snprintf(shown, sizeof(shown), "0x%02x", s->c);
+        fprintf(stderr, "  key %zu (%s, %.3f s into the recording): %.1f us\n",
+                s->index + 1, shown, s->at / 1e6, s->ns / 1e3);
+    }
+}
+
+// Recording
+//
+// The bytes of an escape sequence are held back until it ends: a
+// client's in-band resize (ESC [ 8 ; rows ; cols t) is logged as the
+// r record input_resized writes once the editor applies it, and not as
+// keys too, or a replay would apply it twice.
+
+static void log_key(uint64_t us, unsigned char c) {
+    fprintf(in.log, "%llu k %02x\n", (unsigned long long)us, c);
+}
+
+static void log_held(void) {
+    for (size_t i = 0; i < in.held_len; ++i) log_key(in.held_us[i], in.held[i]);
+    in.held_len = 0;
+}
+
+static void record_key(unsigned char c) {
+    uint64_t us = (now_ns() - in.start) / 1000;
+    if (!in.held_len && c != '\033') {
+        log_key(us, c);
+        return;
+    }
+    in.held[in.held_len] = c;
+    in.held_us[in.held_len++] = us;
+    if (in.held_len == 2 && c != '[') {
+        log_held();         // not a CSI
+    } else if (in.held_len > 2 && c >= 0x40 && c <= 0x7e) {
+        char seq[HELD_MAX];
+        int rows, cols;
+        memcpy(seq, in.held + 2, in.held_len - 3);
+        seq[in.held_len - 3] = '\0';
+        if (c == 't' && sscanf(seq, "8;%d;%d", &rows, &cols) == 2) in.held_len = 0;
+        else log_held();
+    } else if (in.held_len == HELD_MAX) {
+        log_held();         // longer than run_editor reads one
+    }
+}
+
+// Public interface
+
+int input_record(const char *path) {
+    if (!(in.log = fopen(path, "w"))) return -1;
+    setvbuf(in.log, NULL, _IOLBF, 0);      // keep the log up to date should the editor die
+    in.start = now_ns();
+    input_resized();                        // the starting size
+    return 0;
+}
+
+int input_replay(const char *path) {
+    if (!(in.log = fopen(path, "r"))) return -1;
+    in.replaying = 1;
+    set_frame_cap(0);       // the log always polls ready: draw a frame per byte
+    return 0;
+}
+
+int input_fd(void) {
+    return in.replaying ? fileno(in.log) : STDIN_FILENO;   // a file always polls ready
+}
+
+ssize_t input_read(char *c) {
+    uint64_t t = TRACE_BEGIN();
+    ssize_t n = in.replaying ? replay_read(c) : read(STDIN_FILENO, c, 1);
+    TRACE_END(t, "input read");
+    if (n == 1) stats_key();
+    if (n == 1 && in.log && !in.replaying) record_key((unsigned char)*c);
+    return n;
+}
+
+void input_resized(void) {
+    if (!in.log || in.replaying) return;
+    struct winsize w;
+    get_window_size(&w);
+    fprintf(in.log, "%llu r %d %d\n", (unsigned long long)(now_ns() - in.start) / 1000,
+            w.ws_row, w.ws_col);
+}
+
+void input_close(void) {
+    if (in.replaying) replay_report();
+    if (in.log && !in.replaying) log_held();
+    if (in.log) fclose(in.log);
+    free(in.steps);
+    memset(&in, 0, sizeof(in));
+}
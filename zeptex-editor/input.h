@@ -0,0 +1,30 @@
+/* input.h - where run_editor's keys come from
+   Normally the terminal.  --record FILE also logs every byte read and
+   every resize, with the time since the start, one per line (a
+   client's in-band resize sequence only as the resize):
+
+       <us> k <byte in hex>
+       <us> r <rows> <cols>
+
+   --replay FILE reads the bytes from such a log instead of the terminal,
+   as fast as the editor takes them, and applies the resizes at the same
+   points.  Every byte gets its own frame, whatever --fps says, so a
+   replay draws the same frames each run.  The time the editor spends on
+   each byte, its frame included, up to its next read, is recorded and
+   summed up on stderr at exit.  Output goes wherever
+   stdout does, so a replay runs on a terminal or headless
+   (> /dev/null) alike.
+*/
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <sys/types.h>  /* for ssize_t */
+
+int  input_record(const char *path);    /* 0, or -1 with errno */
+int  input_replay(const char *path);
+int  input_fd(void);                    /* to poll for input */
+ssize_t input_read(char *c);            /* as read(2) of one byte */
+void input_resized(void);               /* run_editor saw a resize */
+void input_close(void);                 /* ends the log, prints replay times */
+
+#endif /* INPUT_H */
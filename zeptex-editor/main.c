@@ -0,0 +1,144 @@
+#include "editor.h"
+#include "buffer.h"
+#include "diff.h"
+#include "follow.h"
+#include "highlight.h"
+#include "input.h"
+#include "pager.h"
+#include "reload.h"
+#include "server.h"
+#include "stats.h"
+#include "syntax.h"
+#include "trigram.h"
+
+#include <errno.h>
+
+// ========== MAIN ==========
+
+int main(int argc, char **argv) {
+    const char *filename = NULL;
+    int use_index = 0;
+    int follow = 0;
+    int pager = 0;
+    int serve = 0, client = 0;
+    const char *sock_path = NULL;
+    const char *record = NULL, *replay = NULL;
+    struct syntax *syntaxes[16];
+    size_t syntax_count = 0;
+    uint64_t syntax_ns = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-I") == 0) {
+            use_index = 1;                      // trigram index
+        } else if (strcmp(argv[i], "-f") == 0) {
+            follow = 1;                         // follow appended lines
+        } else if (strcmp(argv[i], "-R") == 0) {
+            pager = 1;                          // read-only pager
+        } else if (strcmp(argv[i], "--server") == 0) {
+            serve = 1;                          // stay resident for --client
+        } else if (strcmp(argv[i], "--client") == 0) {
+            client = 1;
+        } else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            sock_path = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record = argv[++i];                 // log keys and resizes
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay = argv[++i];                 // keys from such a log
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            set_frame_cap((unsigned)strtoul(argv[++i], NULL, 10));     // 0: a frame per input
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+            char err[256];                      // syntax definition file
+            struct syntax *sx = syn_compile_file(argv[++i], err, sizeof(err));
+            if (!sx) {
+                fprintf(stderr, "zeptex: %s\n", err);
+                return 1;
+            }
+            if (syntax_count == sizeof(syntaxes) / sizeof(syntaxes[0]) || hl_register(&sx->hl) < 0) {
+                fprintf(stderr, "zeptex: too many syntax files\n");
+                syn_free(sx);
+                return 1;
+            }
+            syntaxes[syntax_count++] = sx;
+            syntax_ns += sx->compile_ns;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    if (!sock_path) sock_path = server_default_socket();
+    if (serve && server_signals() < 0) {
+        perror("zeptex: signalfd");
+        return 1;
+    }
+    if (client) {
+        for (size_t i = 0; i < syntax_count; ++i) syn_free(syntaxes[i]);
+        return client_run(sock_path);
+    }
+
+    if (follow && !filename) {
+        fprintf(stderr, "zeptex: -f needs a file to follow\n");
+        return 1;
+    }
+    if (pager && (!filename || pager_open(filename) < 0)) {
+        fprintf(stderr, "zeptex: -R needs a regular file: %s\n",
+                filename ? strerror(errno) : "none given");
+        return 1;
+    }
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);     // draw_buffer flushes each frame in one write
+    stats_init();
+    if (replay && (record || serve)) {
+        fprintf(stderr, "zeptex: --replay goes with neither --record nor --server\n");
+        return 1;
+    }
+    if ((record && input_record(record) < 0) || (replay && input_replay(replay) < 0)) {
+        fprintf(stderr, "zeptex: %s: %s\n", record ? record : replay, strerror(errno));
+        return 1;
+    }
+    if (buffer_init(filename) < 0) {
+        fprintf(stderr, "zeptex: out of memory\n");
+        return 1;
+    }
+
+    // Alt screen & cursor off; a server leaves the terminal to its clients
+    if (!serve) {
+        printf("\033[?1049h\033[?25l");
+        enable_raw_mode();
+        setup_sigwinch_handler();
+    }
+
+    if (follow) {
+        if (follow_start(filename) < 0) {
+            set_status("%s: cannot follow: %s", filename, strerror(errno));
+            load_file(filename);
+        }
+    } else if (filename && !pager) {     // the pager reads only what it shows
+        load_file(filename);
+        reload_watch(filename);
+    }
+    hl_select(filename);
+    if (syntax_count)
+        set_status("%zu syntax file(s) compiled in %.2f ms, highlighting: %s", syntax_count,
+                   syntax_ns / 1e6, hl_current() ? hl_current()->name : "none");
+    if (use_index) tri_enable();
+
+    int status = 0;
+    if (serve) {
+        status = server_run(sock_path, filename);
+    } else {
+        run_editor();
+        disable_raw_mode();
+
+        // Restore screen
+        printf("\033[?1049l\033[?25h");
+    }
+    fflush(stdout);
+    input_close();          // after the screen, for the replay times
+
+    follow_stop();
+    diff_close();
+    pager_close();
+    buffer_close_all();
+    for (size_t i = 0; i < syntax_count; ++i) syn_free(syntaxes[i]);
+
+    return status;
+}
@@ -0,0 +1,378 @@
+#include "editor.h"
+#include "pager.h"
+#include "stream.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PAGER_WINDOW   65536            // bytes cached around the view
+#define PAGER_CHUNK    (1 << 20)        // bytes indexed per step
+#define PAGER_MAX_CP   65536            // checkpoints kept at most
+#define PAGER_NOTIFY_NS 100000000       // status refresh while indexing
+
+static struct {
+    struct stream *st;
+    char *name;
+    off_t size;             // decoded size, estimated for compressed files
+    off_t end;              // size if known exactly, else no bound
+
+    off_t top;              // offset of the first line on screen
+    long top_line;          // its 0-based line number, -1 if not known yet
+    int at_end;             // last draw reached the end of the file
+
+    char win[PAGER_WINDOW]; // cached bytes [win_off, win_off + win_len)
+    off_t win_off;
+    size_t win_len;
+
+    // Sparse index, extended by the background builder and (for a view
+    // just past its end) by the main thread, both holding lock
+    pthread_mutex_t lock;
+    off_t *cp;              // cp[k] = start of line k * spacing
+    size_t cp_count;
+    size_t spacing;         // lines between checkpoints
+    off_t indexed;          // bytes [0, indexed) have been scanned
+    size_t indexed_lines;   // newlines seen in them
+    int ends_open;          // last scanned byte is not a newline
+    off_t eof_at;           // where the scan found the end, -1 before
+
+    pthread_t builder;
+    int building;           // builder thread was started
+    int stop;
+    int notify[2];          // builder -> main loop progress pipe
+} pg = { .lock = PTHREAD_MUTEX_INITIALIZER, .notify = { -1, -1 } };
+
+// Window cache
+
+static int fill(off_t start) {
+    ssize_t n;
+    do n = stream_pread(pg.st, pg.win, sizeof(pg.win), start);
+    while (n < 0 && errno == EINTR);
+    pg.win_off = start;
+    pg.win_len = n > 0 ? (size_t)n : 0;
+    return n > 0 ? 0 : -1;
+}
+
+// Cached bytes starting at pos, *len of them
+static const char *span(off_t pos, size_t *len) {
+    if (pos < pg.win_off || pos >= pg.win_off + (off_t)pg.win_len) fill(pos);
+    if (pos < pg.win_off || pos >= pg.win_off + (off_t)pg.win_len) {
+        *len = 0;
+        return pg.win;
+    }
+    *len = (size_t)(pg.win_off + (off_t)pg.win_len - pos);
+    return pg.win + (pos - pg.win_off);
+}
+
+// Whether a line starts at pos
+static int has_line(off_t pos) {
+    size_t n;
+    return pos < pg.end && (span(pos, &n), n > 0);
+}
+
+// Start of the line after the one starting at pos
+static off_t next_line(off_t pos) {
+    while (pos < pg.end) {
+        size_t n;
+        const char *p = span(pos, &n);
+        if (!n) break;                  // end of the data
+        const char *nl = memchr(p, '\n', n);
+        if (nl) return pos + (nl - p) + 1;
+        pos += (off_t)n;
+    }
+    return pos < pg.end ? pos : pg.end;
+}
+
+// Start of the line containing the byte at pos
+static off_t line_start(off_t pos) {
+    while (pos > 0) {
+        if (pos - 1 < pg.win_off || pos - 1 >= pg.win_off + (off_t)pg.win_len) {
+            if (fill(pos > PAGER_WINDOW ? pos - PAGER_WINDOW : 0) < 0) return 0;
+        }
+        for (off_t i = pos - pg.win_off; i > 0; --i)
+            if (pg.win[i - 1] == '\n') return pg.win_off + i;
+        pos = pg.win_off;
+    }
+    return 0;
+}
+
+// Sparse line index
+
+static void add_checkpoint(off_t pos) {
+    if (pg.cp_count == PAGER_MAX_CP) {
+        for (size_t k = 0; 2 * k < pg.cp_count; ++k)
+            pg.cp[k] = pg.cp[2 * k];
+        pg.cp_count = (pg.cp_count + 1) / 2;
+        pg.spacing *= 2;
+        if (pg.indexed_lines % pg.spacing) return;
+    }
+    pg.cp[pg.cp_count++] = pos;
+}
+
+// Scan the next chunk of the file with lock held, returns 0 at the end
+static int index_chunk(void) {
+    static char buf[PAGER_WINDOW];
+    off_t stop = pg.indexed + PAGER_CHUNK;
+    while (pg.indexed < stop) {
+        ssize_t n = stream_pread(pg.st, buf, sizeof(buf), pg.indexed);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            pg.eof_at = pg.indexed;
+            return 0;
+        }
+        for (char *p = buf, *end = buf + n; (p = memchr(p, '\n', (size_t)(end - p))); ++p) {
+            if (++pg.indexed_lines % pg.spacing == 0)
+                add_checkpoint(pg.indexed + (p - buf) + 1);
+        }
+        pg.indexed += n;
+        pg.ends_open = buf[n - 1] != '\n';
+    }
+    return 1;
+}
+
+// Refresh the size: compressed files only have an estimate until they
+// have been decoded to the end; called with lock held
+static void sync_size(void) {
+    int exact;
+    off_t size = stream_size(pg.st, &exact);
+    if (pg.eof_at >= 0) {
+        size = pg.eof_at;
+        exact = 1;
+    }
+    pg.size = !exact && size < pg.indexed ? pg.indexed : size;
+    pg.end = exact ? size : INT64_MAX;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Background builder: index the whole file, poking the main loop now
+// and then so the estimated line count on the status line converges
+static void *index_build(void *arg) {
+    (void)arg;
+    uint64_t last = now_ns();
+    for (;;) {
+        uint64_t t = TRACE_BEGIN();
+        pthread_mutex_lock(&pg.lock);
+        int more = !pg.stop && index_chunk();
+        pthread_mutex_unlock(&pg.lock);
+        TRACE_END(t, "pager index");
+        if (!more || now_ns() - last >= PAGER_NOTIFY_NS) {
+            (void)write(pg.notify[1], "", 1);  // if full, a wake-up is pending
+            last = now_ns();
+        }
+        if (!more) return NULL;
+    }
+}
+
+// Line number of the line starting at pos, which must be indexed;
+// called with lock held
+static long line_of(off_t pos) {
+    size_t lo = 0, hi = pg.cp_count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (pg.cp[mid] <= pos) lo = mid;
+        else hi = mid;
+    }
+    long line = (long)(lo * pg.spacing);
+    for (off_t p = pg.cp[lo]; p < pos; p = next_line(p)) line++;
+    return line;
+}
+
+// Public interface
+
+int pager_open(const char *filename) {
+    struct stat st;
+    pg.st = stream_open(filename, STREAM_READ);
+    if (pg.st && (fstat(pg.st->fd, &st) < 0 || !S_ISREG(st.st_mode))) {
+        stream_close(pg.st);
+        pg.st = NULL;
+        errno = EINVAL;
+    }
+    if (!pg.st) return -1;
+    pg.cp = malloc(PAGER_MAX_CP * sizeof(*pg.cp));
+    pg.name = strdup(filename);
+    if (!pg.cp || !pg.name || pipe(pg.notify) < 0) {
+        pager_close();
+        return -1;
+    }
+    for (int i = 0; i < 2; ++i) fcntl(pg.notify[i], F_SETFL, O_NONBLOCK);
+    pg.eof_at = -1;
+    pg.cp[0] = 0;
+    pg.cp_count = 1;
+    pg.spacing = 64;
+    pg.top = pg.indexed = pg.win_off = 0;
+    pg.top_line = 0;
+    pg.indexed_lines = pg.win_len = 0;
+    pg.at_end = pg.ends_open = 0;
+    pg.building = pg.stop = 0;
+    sync_size();
+    return 0;
+}
+
+int pager_active(void) {
+    return pg.st != NULL;
+}
+
+int pager_fd(void) {
+    return pg.notify[0];
+}
+
+int pager_update(void) {
+    char buf[64];
+    int poked = 0;
+    while (read(pg.notify[0], buf, sizeof(buf)) > 0) poked = 1;
+    return poked;
+}
+
+void pager_close(void) {
+    if (pg.building) {
+        pthread_mutex_lock(&pg.lock);
+        pg.stop = 1;
+        pthread_mutex_unlock(&pg.lock);
+        pthread_join(pg.builder, NULL);
+        pg.building = 0;
+    }
+    for (int i = 0; i < 2; ++i) {
+        if (pg.notify[i] >= 0) close(pg.notify[i]);
+        pg.notify[i] = -1;
+    }
+    if (pg.st) stream_close(pg.st);
+    free(pg.cp);
+    free(pg.name);
+    pg.st = NULL;
+    pg.cp = NULL;
+    pg.name = NULL;
+}
+
+void pager_draw(size_t rows, int cols) {
+    pthread_mutex_lock(&pg.lock);
+    sync_size();
+    pthread_mutex_unlock(&pg.lock);
+
+    // Keep the last page full
+    off_t pos = pg.top;
+    size_t shown = 0;
+    while (shown < rows && has_line(pos)) {
+        pos = next_line(pos);
+        shown++;
+    }
+    while (shown < rows && pg.top > 0) {
+        pg.top = line_start(pg.top - 1);
+        if (pg.top_line > 0) pg.top_line--;
+        shown++;
+    }
+
+    // Index on demand while the view moves on from the indexed part; a
+    // far jump leaves line numbers unknown until the builder gets there
+    pthread_mutex_lock(&pg.lock);
+    while (pos > pg.indexed && pos - pg.indexed <= PAGER_CHUNK && index_chunk())
+        ;
+    if (pg.top_line < 0 && pg.top <= pg.indexed) pg.top_line = line_of(pg.top);
+    pthread_mutex_unlock(&pg.lock);
+
+    pos = pg.top;
+    for (size_t i = 0; i < rows; ++i) {
+        if (!has_line(pos)) {
+            printf("~\n");
+            continue;
+        }
+        int prefix = pg.top_line >= 0 ? printf("%3ld | ", pg.top_line + (long)i + 1)
+                                      : printf("  ? | ");
+        size_t width = cols > prefix ? (size_t)(cols - prefix) : 0;
+
+        // A column takes up to 4 bytes (UTF-8), so have that many cached
+        size_t n;
+        const char *p = span(pos, &n);
+        const char *nl = memchr(p, '\n', n);
+        if (!nl && n < 4 * width && pos + (off_t)n < pg.end) {
+            fill(pos);
+            p = span(pos, &n);
+            nl = memchr(p, '\n', n);
+        }
+        draw_text(p, nl ? (size_t)(nl - p) : n, 0, width);
+        printf("\n");
+        pos = next_line(pos);
+    }
+    pg.at_end = !has_line(pos);
+
+    // The first screen is up, index the rest in the background
+    if (!pg.building)
+        pg.building = pthread_create(&pg.builder, NULL, index_build, NULL) == 0;
+}
+
+void pager_scroll(int dir) {
+    if (dir > 0 && !pg.at_end) {
+        pg.top = next_line(pg.top);
+        if (pg.top_line >= 0) pg.top_line++;
+    } else if (dir < 0 && pg.top > 0) {
+        pg.top = line_start(pg.top - 1);
+        if (pg.top_line > 0) pg.top_line--;
+    }
+}
+
+void pager_command(const char *cmd) {
+    char *end;
+    if (cmd[0] == '%') {
+        double pct = strtod(cmd + 1, &end);
+        if (end == cmd + 1 || *end || pct < 0 || pct > 100) {
+            set_status("Use: %%N with N from 0 to 100");
+            return;
+        }
+        pg.top = line_start((off_t)(pg.size * (pct / 100.0)));
+        pg.top_line = -1;
+    } else if (cmd[0] == 'g' && cmd[1] == ' ') {
+        long n = strtol(cmd + 2, &end, 10);
+        if (end == cmd + 2 || *end || n <= 0) {
+            set_status("Use: g <line>");
+            return;
+        }
+        pthread_mutex_lock(&pg.lock);
+        while (pg.indexed_lines < (size_t)n - 1 && index_chunk())
+            ;
+        if (pg.indexed_lines < (size_t)n - 1) n = (long)pg.indexed_lines + 1;
+        size_t k = (size_t)(n - 1) / pg.spacing;
+        if (k >= pg.cp_count) k = pg.cp_count - 1;
+        off_t pos = pg.cp[k];
+        long line = (long)(k * pg.spacing);
+        pthread_mutex_unlock(&pg.lock);
+
+        for (; line < n - 1; ++line) pos = next_line(pos);
+        pg.top = pos;
+        pg.top_line = n - 1;
+    } else if (cmd[0]) {
+        set_status("Read-only pager: %%N jumps to N%%, g N to line N, q quits");
+    }
+}
+
+const char *pager_position(void) {
+    static char buf[256];
+    pthread_mutex_lock(&pg.lock);
+    sync_size();
+    int done = pg.eof_at >= 0;
+    double indexed = pg.size ? 100.0 * (double)pg.indexed / (double)pg.size : 100.0;
+    if (indexed > 99.9) indexed = 99.9;         // until the end is found
+    size_t total = pg.indexed_lines + (done && pg.ends_open);
+    if (!done && pg.indexed)                // extrapolate from the part seen
+        total = (size_t)((double)pg.indexed_lines * ((double)pg.size / (double)pg.indexed));
+    pthread_mutex_unlock(&pg.lock);
+
+    char where[64];
+    if (pg.top_line >= 0) snprintf(where, sizeof(where), "line %ld", pg.top_line + 1);
+    else snprintf(where, sizeof(where), "byte %lld", (long long)pg.top);
+    snprintf(buf, sizeof(buf), "%s  %s of %s%zu lines  %.1f%%", pg.name, where,
+             done ? "" : "~", total, pg.size ? 100.0 * (double)pg.top / (double)pg.size : 100.0);
+    if (!done)
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "  (indexing %.0f%%)", indexed);
+    return buf;
+}
@@ -0,0 +1,30 @@
+/* pager.h - read-only pager for files too big to load (-R)
+   Nothing is read up front.  The view is anchored at a byte offset and
+   only the lines on screen are read, through a small window cache.  A
+   sparse index (one checkpoint every K lines) is built chunk by chunk
+   on a background thread once the first screen is shown, and on demand
+   when the view runs ahead of it; when it fills up K doubles and every
+   other checkpoint is dropped, so memory stays bounded whatever the
+   size of the file.  Until it is complete the total line count on the
+   status line is extrapolated from the part indexed so far.
+*/
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <stddef.h>   /* for size_t */
+
+int  pager_open(const char *filename);  /* 0 on success, -1 on error    */
+int  pager_active(void);
+void pager_close(void);
+
+/*--------------------------------------------------------------------
+  Called by draw_buffer / run_editor in place of the buffer code
+ --------------------------------------------------------------------*/
+void pager_draw(size_t rows, int cols);     /* rows of text at the view */
+void pager_scroll(int dir);                 /* one line, -1 or +1       */
+void pager_command(const char *cmd);        /* %N, g N                  */
+const char *pager_position(void);           /* status line text         */
+int  pager_fd(void);                        /* readable on index progress */
+int  pager_update(void);                    /* 1 when a redraw is due   */
+
+#endif /* PAGER_H */
@@ -0,0 +1,292 @@
+#include "editor.h"
+#include "reload.h"
+#include "stream.h"
+#include "watch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RELOAD_BLOCK 4096
+
+static struct reload_state {
+    struct file_watch w;
+    size_t size;            // file size at the last snapshot
+    size_t *off;            // start of each line, off[count] = size
+    size_t count, cap;
+    int open_tail;          // last line has no newline and may still grow
+    uint64_t *head;         // hash of block k counted from the start
+    uint64_t *tail;         // hash of block k counted from the end
+    size_t blocks;          // whole blocks in the file
+} rl = { { NULL, -1, -1, -1, 0 }, 0, NULL, 0, 0, 0, NULL, NULL, 0 };
+
+static const struct reload_state rl_none = { { NULL, -1, -1, -1, 0 }, 0, NULL, 0, 0, 0, NULL, NULL, 0 };
+
+// Helpers
+
+static uint64_t block_hash(const unsigned char *p) {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < RELOAD_BLOCK; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h = (h ^ v) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+static int read_at(int fd, void *buf, size_t n, size_t pos) {
+    for (size_t got = 0; got < n;) {
+        ssize_t r = pread(fd, (char *)buf + got, n - got, (off_t)(pos + got));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        got += (size_t)r;
+    }
+    return 0;
+}
+
+// Splits text into lines as load_file() does.  Returns the bytes that
+// end the current line, newline included, or 0 if it continues past n.
+static size_t split_next(size_t *piece_len, const char *p, size_t n) {
+    const char *nl = memchr(p, '\n', n);
+    if (nl) {
+        *piece_len = 0;
+        return (size_t)(nl - p) + 1;
+    }
+    *piece_len += n;
+    return 0;
+}
+
+static int push_off(size_t pos) {
+    if (rl.count + 1 >= rl.cap) {
+        size_t cap = rl.cap ? rl.cap * 2 : 1024;
+        size_t *grown = realloc(rl.off, cap * sizeof(*grown));
+        if (!grown) return -1;
+        rl.off = grown;
+        rl.cap = cap;
+    }
+    rl.off[rl.count++] = pos;
+    return 0;
+}
+
+// Record line offsets and block hashes of the file as it is now
+static int snapshot(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) return -1;
+    size_t size = (size_t)st.st_size, blocks = size / RELOAD_BLOCK;
+
+    free(rl.head);
+    free(rl.tail);
+    rl.head = malloc((blocks + 1) * sizeof(uint64_t));
+    rl.tail = malloc((blocks + 1) * sizeof(uint64_t));
+    rl.count = 0;
+    rl.blocks = 0;
+    if (!rl.head || !rl.tail) return -1;
+
+    unsigned char buf[RELOAD_BLOCK];
+    size_t piece_len = 0;
+    int in_line = 0;
+    for (size_t pos = 0; pos < size; pos += RELOAD_BLOCK) {
+        size_t n = size - pos < RELOAD_BLOCK ? size - pos : RELOAD_BLOCK;
+        if (read_at(fd, buf, n, pos) < 0) return -1;
+        if (n == RELOAD_BLOCK) rl.head[pos / RELOAD_BLOCK] = block_hash(buf);
+        for (size_t i = 0; i < n;) {
+            if (!in_line && push_off(pos + i) < 0) return -1;
+            size_t k = split_next(&piece_len, (const char *)buf + i, n - i);
+            in_line = !k;
+            if (!k) break;
+            i += k;
+        }
+    }
+    for (size_t k = 0; k < blocks; ++k) {
+        if (read_at(fd, buf, RELOAD_BLOCK, size - (k + 1) * RELOAD_BLOCK) < 0) return -1;
+        rl.tail[k] = block_hash(buf);
+    }
+    if (push_off(size) < 0) return -1;
+    rl.count--;                         // off[count] is the end sentinel
+    rl.size = size;
+    rl.open_tail = in_line;
+    rl.blocks = blocks;
+    return 0;
+}
+
+// First index in off[0..count] whose offset is greater than pos
+static size_t upper_line(size_t pos) {
+    size_t lo = 0, hi = rl.count + 1;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (rl.off[mid] > pos) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// Merge the changed part of the file into the buffer
+static int merge(int fd) {
+    if (buffer_dirty) {
+        set_status("%s changed on disk; not reloaded over unsaved edits", rl.w.path);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) return 0;
+    size_t osize = rl.size, nsize = (size_t)st.st_size;
+    size_t limit = osize < nsize ? osize : nsize;
+
+    // Common prefix and suffix, in whole blocks
+    unsigned char buf[RELOAD_BLOCK];
+    size_t pre = 0, suf = 0;
+    while (pre / RELOAD_BLOCK < rl.blocks && pre + RELOAD_BLOCK <= limit &&
+           read_at(fd, buf, RELOAD_BLOCK, pre) == 0 &&
+           block_hash(buf) == rl.head[pre / RELOAD_BLOCK])
+        pre += RELOAD_BLOCK;
+    while (suf / RELOAD_BLOCK < rl.blocks && pre + suf + RELOAD_BLOCK <= limit &&
+           read_at(fd, buf, RELOAD_BLOCK, nsize - suf - RELOAD_BLOCK) == 0 &&
+           block_hash(buf) == rl.tail[suf / RELOAD_BLOCK])
+        suf += RELOAD_BLOCK;
+
+    // Old lines [first, last) overlap the bytes that differ
+    size_t first = upper_line(pre) - 1;
+    if (rl.open_tail && first == rl.count && first > 0) first--;
+    size_t last = upper_line(osize - suf);
+    if (last > rl.count) last = rl.count;
+    size_t start = rl.off[first];
+    size_t end = nsize - (osize - rl.off[last]);
+
+    char *text = NULL, **piece = NULL;
+    size_t m = 0;
+    int merged = 0;
+    for (;;) {
+        size_t len = end - start;
+        text = malloc(len + 1);
+        piece = malloc((len + 1) * sizeof(*piece));
+        if (!text || !piece || read_at(fd, text, len, start) < 0) goto out;
+
+        size_t piece_len = 0;
+        for (size_t i = 0; i < len;) {
+            size_t k = split_next(&piece_len, text + i, len - i);
+            size_t n = k ? k : len - i;
+            if (!(piece[m] = strndup(text + i, n - (text[i + n - 1] == '\n')))) goto out;
+            m++;
+            i += n;
+        }
+        if (!piece_len || end == nsize) break;
+
+        // The range ends inside a line, so the pieces after it may shift
+        while (m > 0) free(piece[--m]);
+        free(text);
+        free(piece);
+        last = rl.count;
+        end = nsize;
+    }
+
+    if (line_count - (last - first) + m > MAX_LINES) {
+        set_status("%s changed on disk but no longer fits in the buffer", rl.w.path);
+        goto out;
+    }
+
+    // Skip lines that came back unchanged at either end of the range
+    size_t a = 0, b = 0;
+    while (a < m && first + a < last && strcmp(lines[first + a], piece[a]) == 0) a++;
+    while (b < m - a && last - b > first + a &&
+           strcmp(lines[last - 1 - b], piece[m - 1 - b]) == 0) b++;
+
+    size_t del = last - b - first - a, ins = m - a - b;
+    size_t view = scroll_offset;
+    for (size_t k = 0; k < del; ++k) delete_line(first + a + 1);
+    for (size_t k = 0; k < ins; ++k) insert_line(first + a + k + 1, piece[a + k]);
+    if (last - b <= view) view = view - del + ins;  // keep the same text on screen
+    scroll_offset = view;
+    buffer_dirty = 0;
+    merged = 1;
+
+    if (del || ins)
+        set_status("%s changed on disk: %zu line(s) at %zu replaced by %zu (%zu bytes read)",
+                   rl.w.path, del, first + a + 1, ins, end - start);
+
+out:
+    while (m > 0) free(piece[--m]);
+    free(text);
+    free(piece);
+    if (merged && (snapshot(fd) < 0 || rl.count != line_count)) {
+        set_status("%s: lost track of the file on disk, not watching it", rl.w.path);
+        reload_stop();
+    }
+    return 1;
+}
+
+// Public interface
+
+int reload_watch(const char *filename) {
+    reload_stop();
+    if (stream_compressed(filename)) return -1;     // offsets would not match
+    if (watch_open(&rl.w, filename, IN_CLOSE_WRITE) < 0) return -1;
+
+    int fd = open(rl.w.path, O_RDONLY);
+    int ok = fd >= 0 && snapshot(fd) == 0 && rl.count == line_count;
+    if (fd >= 0) close(fd);
+    if (!ok) {
+        reload_stop();
+        return -1;
+    }
+    return 0;
+}
+
+int reload_fd(void) {
+    return rl.w.ino;
+}
+
+int reload_update(void) {
+    int events = watch_poll(&rl.w);
+    if (!events) return 0;
+    if (events & WATCH_REPLACED) watch_rearm(&rl.w);
+
+    int fd = open(rl.w.path, O_RDONLY);
+    if (fd < 0) return 0;               // gone for now, wait for it to return
+    int redraw = merge(fd);
+    close(fd);
+    return redraw;
+}
+
+void reload_resync(void) {
+    if (rl.w.ino < 0) return;
+    int fd = open(rl.w.path, O_RDONLY);
+    if (fd < 0 || snapshot(fd) < 0 || rl.count != line_count) reload_stop();
+    if (fd >= 0) close(fd);
+}
+
+// A hidden buffer keeps its watch open; changes that arrive meanwhile
+// are queued by inotify and merged once it is shown again
+void *reload_park(void) {
+    if (rl.w.ino < 0) return NULL;
+    struct reload_state *saved = malloc(sizeof(*saved));
+    if (!saved) {
+        reload_stop();
+        return NULL;
+    }
+    *saved = rl;
+    rl = rl_none;
+    return saved;
+}
+
+void reload_unpark(void *state) {
+    reload_stop();
+    if (!state) return;
+    rl = *(struct reload_state *)state;
+    free(state);
+}
+
+void reload_stop(void) {
+    watch_close(&rl.w);
+    free(rl.off);
+    free(rl.head);
+    free(rl.tail);
+    rl.off = NULL;
+    rl.head = rl.tail = NULL;
+    rl.count = rl.cap = rl.blocks = rl.size = 0;
+}
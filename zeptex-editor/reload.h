@@ -0,0 +1,20 @@
+/* reload.h - notice external changes to the open file and merge them
+   When the file is loaded its line offsets and two sets of block
+   hashes (blocks aligned to the start and to the end of the file) are
+   recorded.  When another process rewrites it, the new file is hashed
+   the same way to find the common prefix and suffix, and only the lines
+   in between are read again and merged into the buffer.
+*/
+#ifndef RELOAD_H
+#define RELOAD_H
+
+int  reload_watch(const char *filename);   /* after load_file()       */
+int  reload_fd(void);                      /* fd to poll, -1 if none  */
+int  reload_update(void);                  /* 1 when a redraw is due  */
+void reload_resync(void);                  /* after saving the file   */
+void reload_stop(void);
+
+void *reload_park(void);                   /* per-buffer state, for   */
+void reload_unpark(void *state);           /* buffer.c                */
+
+#endif /* RELOAD_H */
@@ -0,0 +1,479 @@
+#include "editor.h"
+#include "search.h"
+#include "trigram.h"
+
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct search_result last_search;
+
+static int search_stale = 0;    // buffer edited since the last query
+static char *last_query = NULL;
+static int last_regex = 0;      // last_query is an extended regex
+
+// Aho-Corasick automaton
+
+// Append a fresh state with no outgoing edges, returns its id or -1
+static int ac_new_state(struct ac_automaton *ac) {
+    if (ac->state_count == ac->state_cap) {
+        size_t cap = ac->state_cap ? ac->state_cap * 2 : 64;
+        int (*next)[256] = realloc(ac->next, cap * sizeof(*next));
+        if (!next) return -1;
+        ac->next = next;
+        int *out = realloc(ac->out, cap * sizeof(int));
+        if (!out) return -1;
+        ac->out = out;
+        int *dict = realloc(ac->dict, cap * sizeof(int));
+        if (!dict) return -1;
+        ac->dict = dict;
+        ac->state_cap = cap;
+    }
+    int s = (int)ac->state_count++;
+    memset(ac->next[s], -1, sizeof(ac->next[s]));
+    ac->out[s] = -1;
+    ac->dict[s] = -1;
+    return s;
+}
+
+// Build the automaton for pat_count non-empty patterns
+int ac_build(struct ac_automaton *ac, char **pats, size_t pat_count) {
+    memset(ac, 0, sizeof(*ac));
+    if (ac_new_state(ac) < 0) goto fail;
+
+    // Trie of all patterns; duplicates share their final state
+    for (size_t p = 0; p < pat_count; ++p) {
+        int s = 0;
+        for (const unsigned char *c = (const unsigned char *)pats[p]; *c; ++c) {
+            if (ac->next[s][*c] < 0) {
+                int t = ac_new_state(ac);
+                if (t < 0) goto fail;
+                ac->next[s][*c] = t;
+            }
+            s = ac->next[s][*c];
+        }
+        if (ac->out[s] < 0) ac->out[s] = (int)p;
+    }
+
+    // Breadth-first pass turning the trie into a full DFA
+    int *fail = malloc(ac->state_count * sizeof(int));
+    int *queue = malloc(ac->state_count * sizeof(int));
+    if (!fail || !queue) {
+        free(fail);
+        free(queue);
+        goto fail;
+    }
+    size_t head = 0, tail = 0;
+    fail[0] = 0;
+    for (int c = 0; c < 256; ++c) {
+        int t = ac->next[0][c];
+        if (t < 0) {
+            ac->next[0][c] = 0;
+        } else {
+            fail[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        int s = queue[head++];
+        int f = fail[s];
+        ac->dict[s] = ac->out[f] >= 0 ? f : ac->dict[f];
+        for (int c = 0; c < 256; ++c) {
+            int t = ac->next[s][c];
+            if (t < 0) {
+                ac->next[s][c] = ac->next[f][c];
+            } else {
+                fail[t] = ac->next[f][c];
+                queue[tail++] = t;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+    return 0;
+
+fail:
+    ac_free(ac);
+    return -1;
+}
+
+void ac_free(struct ac_automaton *ac) {
+    free(ac->next);
+    free(ac->out);
+    free(ac->dict);
+    memset(ac, 0, sizeof(*ac));
+}
+
+// Query handling
+
+void search_clear(void) {
+    for (size_t i = 0; i < last_search.pat_count; ++i)
+        free(last_search.pats[i]);
+    free(last_search.pats);
+    free(last_search.pat_hits);
+    free(last_search.jump);
+    memset(&last_search, 0, sizeof(last_search));
+}
+
+// Split "{a|b|c}" into its literals, anything else is one literal
+static int parse_query(const char *query) {
+    size_t len = strlen(query);
+    int multi = len >= 2 && query[0] == '{' && query[len - 1] == '}';
+    const char *p = multi ? query + 1 : query;
+    const char *end = multi ? query + len - 1 : query + len;
+
+    size_t cap = 1;
+    for (const char *q = p; multi && q < end; ++q)
+        if (*q == '|') cap++;
+
+    last_search.pats = calloc(cap, sizeof(char *));
+    if (!last_search.pats) return -1;
+
+    for (;;) {
+        const char *bar = p;
+        while (multi && bar < end && *bar != '|') bar++;
+        if (!multi) bar = end;
+        if (bar > p) {
+            char *pat = strndup(p, (size_t)(bar - p));
+            if (!pat) return -1;
+            last_search.pats[last_search.pat_count++] = pat;
+        }
+        if (bar >= end) break;
+        p = bar + 1;
+    }
+    return 0;
+}
+
+static void remember_query(const char *query, int regex) {
+    search_clear();
+    search_stale = 0;
+    if (query != last_query) {
+        free(last_query);
+        last_query = strdup(query);
+    }
+    last_regex = regex;
+}
+
+static int cmp_line(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Lines that can contain one of pats according to the trigram index,
+// sorted; NULL when every line has to be scanned
+static size_t *candidate_lines(char **pats, const size_t *lens, size_t pat_count, size_t *n) {
+    size_t *all = NULL, total = 0;
+    for (size_t p = 0; p < pat_count; ++p) {
+        size_t *cand;
+        long k = tri_candidates(pats[p], lens[p], &cand);
+        if (k < 0) {
+            free(all);
+            *n = line_count;
+            return NULL;
+        }
+        size_t *grown = realloc(all, (total + (size_t)k + 1) * sizeof(size_t));
+        if (!grown) {
+            free(cand);
+            free(all);
+            *n = line_count;
+            return NULL;
+        }
+        all = grown;
+        if (k) memcpy(all + total, cand, (size_t)k * sizeof(size_t));
+        total += (size_t)k;
+        free(cand);
+    }
+
+    if (pat_count > 1 && total) {
+        qsort(all, total, sizeof(size_t), cmp_line);
+        size_t k = 1;
+        for (size_t i = 1; i < total; ++i)
+            if (all[i] != all[k - 1]) all[k++] = all[i];
+        total = k;
+    }
+    *n = total;
+    return all;
+}
+
+// Status: "N matching lines | pat=hits pat=hits ...", then jump
+static void search_report(void) {
+    char msg[256];
+    int len = snprintf(msg, sizeof(msg), "%zu matching lines |", last_search.jump_count);
+    for (size_t p = 0; p < last_search.pat_count && len < (int)sizeof(msg); ++p)
+        len += snprintf(msg + len, sizeof(msg) - len, " %s=%zu",
+                        last_search.pats[p], last_search.pat_hits[p]);
+    set_status("%s", msg);
+
+    if (last_search.jump_count) search_jump(0);
+}
+
+// Run a literal query over the buffer, filling last_search
+int search_run(const char *query) {
+    remember_query(query, 0);
+
+    if (parse_query(query) < 0) {
+        set_status("Search: out of memory");
+        return -1;
+    }
+    if (last_search.pat_count == 0) {
+        set_status("Search: empty pattern. Use: /text or /{a|b|c}");
+        return -1;
+    }
+
+    struct ac_automaton ac;
+    if (ac_build(&ac, last_search.pats, last_search.pat_count) < 0) {
+        set_status("Search: out of memory");
+        return -1;
+    }
+
+    size_t *lens = malloc(last_search.pat_count * sizeof(size_t));
+    size_t *state_hits = calloc(ac.state_count, sizeof(size_t));
+    last_search.pat_hits = calloc(last_search.pat_count, sizeof(size_t));
+    last_search.jump = malloc((line_count ? line_count : 1) * sizeof(size_t));
+    if (!lens || !state_hits || !last_search.pat_hits || !last_search.jump) {
+        free(lens);
+        free(state_hits);
+        ac_free(&ac);
+        search_clear();
+        set_status("Search: out of memory");
+        return -1;
+    }
+    for (size_t p = 0; p < last_search.pat_count; ++p)
+        lens[p] = strlen(last_search.pats[p]);
+
+    size_t scan_count;
+    size_t *cand = candidate_lines(last_search.pats, lens, last_search.pat_count, &scan_count);
+    free(lens);
+
+    // One pass over the (candidate) lines; matches never span lines
+    for (size_t k = 0; k < scan_count; ++k) {
+        size_t i = cand ? cand[k] : k;
+        int s = 0, hit = 0;
+        for (const unsigned char *c = (const unsigned char *)lines[i]; *c; ++c) {
+            s = ac.next[s][*c];
+            for (int t = ac.out[s] >= 0 ? s : ac.dict[s]; t >= 0; t = ac.dict[t]) {
+                state_hits[t]++;
+                hit = 1;
+            }
+        }
+        if (hit) last_search.jump[last_search.jump_count++] = i;
+    }
+    free(cand);
+
+    // Map hits back from final states to patterns
+    for (size_t p = 0; p < last_search.pat_count; ++p) {
+        int s = 0;
+        for (const unsigned char *c = (const unsigned char *)last_search.pats[p]; *c; ++c)
+            s = ac.next[s][*c];
+        last_search.pat_hits[p] = state_hits[s];
+    }
+    free(state_hits);
+    ac_free(&ac);
+
+    search_report();
+    return 0;
+}
+
+// Longest literal every match of the extended regex re must contain,
+// copied into buf; 0 when there is none (e.g. top-level alternation)
+static size_t regex_required(const char *re, char *buf, size_t cap) {
+    char run[MAX_LINE_LEN];
+    size_t run_len = 0, best = 0;
+    const char *p = re;
+
+    while (*p) {
+        int lit = -1;
+        if (*p == '|') {
+            return 0;
+        } else if (*p == '\\' && p[1]) {
+            // \w, \b, \< and friends are GNU classes, not literals
+            if (!((p[1] >= 'a' && p[1] <= 'z') || (p[1] >= 'A' && p[1] <= 'Z') ||
+                  (p[1] >= '0' && p[1] <= '9')))
+                lit = (unsigned char)p[1];
+            p += 2;
+        } else if (*p == '[') {
+            p++;
+            if (*p == '^') p++;
+            if (*p == ']') p++;
+            while (*p && *p != ']') {
+                if (*p == '[' && (p[1] == ':' || p[1] == '=' || p[1] == '.')) {
+                    const char *close = strchr(p + 2, ']');
+                    p = close ? close : p + 1;
+                }
+                p++;
+            }
+            if (*p) p++;
+        } else if (*p == '(') {
+            int depth = 0;
+            do {
+                if (*p == '\\' && p[1]) p++;
+                else if (*p == '(') depth++;
+                else if (*p == ')') depth--;
+                p++;
+            } while (*p && depth > 0);
+        } else if (*p == '.' || *p == '^' || *p == '$') {
+            p++;
+        } else {
+            lit = (unsigned char)*p++;
+        }
+
+        // A quantifier that allows zero repeats drops the atom, '+' keeps
+        // one copy but nothing after it is adjacent any more
+        int optional = *p == '*' || *p == '?' || *p == '{';
+        int plus = *p == '+';
+        if (lit >= 0 && !optional && run_len < sizeof(run))
+            run[run_len++] = (char)lit;
+        if (lit < 0 || optional || plus) {
+            if (run_len > best && run_len <= cap) {
+                memcpy(buf, run, run_len);
+                best = run_len;
+            }
+            run_len = 0;
+        }
+        if (*p == '{') {
+            const char *close = strchr(p, '}');
+            p = close ? close + 1 : p + 1;
+        } else if (optional || plus) {
+            p++;
+        }
+    }
+    if (run_len > best && run_len <= cap) {
+        memcpy(buf, run, run_len);
+        best = run_len;
+    }
+    return best;
+}
+
+// Run an extended regular expression over the buffer, filling last_search
+int search_run_regex(const char *re) {
+    remember_query(re, 1);
+
+    regex_t rx;
+    int err = regcomp(&rx, re, REG_EXTENDED | REG_NEWLINE);
+    if (err) {
+        char why[128];
+        regerror(err, &rx, why, sizeof(why));
+        set_status("Search: %s", why);
+        return -1;
+    }
+
+    last_search.pats = malloc(sizeof(char *));
+    last_search.pat_hits = calloc(1, sizeof(size_t));
+    last_search.jump = malloc((line_count ? line_count : 1) * sizeof(size_t));
+    if (last_search.pats) last_search.pats[0] = strdup(re);
+    if (!last_search.pats || !last_search.pats[0] || !last_search.pat_hits || !last_search.jump) {
+        if (last_search.pats && last_search.pats[0]) last_search.pat_count = 1;
+        regfree(&rx);
+        search_clear();
+        set_status("Search: out of memory");
+        return -1;
+    }
+    last_search.pat_count = 1;
+
+    char lit[MAX_LINE_LEN];
+    char *lit_pat = lit;
+    size_t lit_len = regex_required(re, lit, sizeof(lit));
+    size_t scan_count;
+    size_t *cand = candidate_lines(&lit_pat, &lit_len, lit_len ? 1 : 0, &scan_count);
+    if (!lit_len) {
+        free(cand);
+        cand = NULL;
+        scan_count = line_count;
+    }
+
+    for (size_t k = 0; k < scan_count; ++k) {
+        size_t i = cand ? cand[k] : k;
+        const char *s = lines[i];
+        regmatch_t m;
+        int eflags = 0, hit = 0;
+        while (regexec(&rx, s, 1, &m, eflags) == 0) {
+            last_search.pat_hits[0]++;
+            hit = 1;
+            // Step past the match, or one byte past an empty one
+            if (m.rm_eo == m.rm_so && !s[m.rm_eo]) break;
+            s += m.rm_eo > m.rm_so ? m.rm_eo : m.rm_eo + 1;
+            if (!*s) break;
+            eflags = REG_NOTBOL;
+        }
+        if (hit) last_search.jump[last_search.jump_count++] = i;
+    }
+    free(cand);
+    regfree(&rx);
+
+    search_report();
+    return 0;
+}
+
+// Scroll to the next (dir > 0), previous (dir < 0) or first hit at or
+// after the current position (dir == 0)
+void search_jump(int dir) {
+    if (search_stale && last_query) {
+        if (last_regex) search_run_regex(last_query);
+        else search_run(last_query);
+        if (dir == 0) return;
+    }
+    if (!last_search.jump_count) {
+        set_status("%s", last_query ? "Search: no matches" : "Search: no previous query");
+        return;
+    }
+
+    // Binary search the first hit at or after scroll_offset
+    size_t lo = 0, hi = last_search.jump_count;
+    size_t from = dir > 0 ? scroll_offset + 1 : scroll_offset;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (last_search.jump[mid] < from) lo = mid + 1;
+        else hi = mid;
+    }
+
+    size_t k;
+    if (dir < 0)
+        k = lo ? lo - 1 : last_search.jump_count - 1;       // wrap to last
+    else
+        k = lo < last_search.jump_count ? lo : 0;           // wrap to first
+
+    scroll_offset = last_search.jump[k];
+}
+
+void search_buffer_changed(void) {
+    search_stale = 1;
+}
+
+// Per-buffer state
+
+struct search_state {
+    struct search_result result;
+    int stale;
+    char *query;
+    int regex;
+};
+
+void *search_park(void) {
+    struct search_state *saved = malloc(sizeof(*saved));
+    if (saved) {
+        *saved = (struct search_state){ last_search, search_stale, last_query, last_regex };
+        memset(&last_search, 0, sizeof(last_search));
+    } else {
+        search_clear();     // out of memory: the buffer forgets its query
+        free(last_query);
+    }
+    search_stale = 0;
+    last_query = NULL;
+    last_regex = 0;
+    return saved;
+}
+
+void search_unpark(void *state) {
+    struct search_state st = { { NULL, 0, NULL, NULL, 0 }, 0, NULL, 0 };
+    if (state) {
+        st = *(struct search_state *)state;
+        free(state);
+    }
+    search_clear();
+    free(last_query);
+    last_search = st.result;
+    search_stale = st.stale;
+    last_query = st.query;
+    last_regex = st.regex;
+}
@@ -0,0 +1,51 @@
+/* search.h - literal, multi-literal and regex search over the buffer
+   A query is either a single literal ("/foo") or a brace list of
+   literals ("/{foo|bar|baz}").  All patterns are matched in one pass
+   over the buffer with an Aho-Corasick automaton built per query.
+   "?re" runs a POSIX extended regex instead.  When the trigram index
+   is enabled both kinds only visit the lines it reports as candidates.
+*/
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>   /* for size_t */
+
+/*--------------------------------------------------------------------
+  Aho-Corasick automaton (dense DFA, one row of 256 edges per state)
+ --------------------------------------------------------------------*/
+struct ac_automaton {
+    int (*next)[256];       /* goto + failure folded into a full DFA   */
+    int *out;               /* pattern id ending in this state, or -1  */
+    int *dict;              /* nearest accepting suffix state, or -1   */
+    size_t state_count;
+    size_t state_cap;
+};
+
+int  ac_build(struct ac_automaton *ac, char **pats, size_t pat_count);
+void ac_free(struct ac_automaton *ac);
+
+/*--------------------------------------------------------------------
+  Search results of the last query
+ --------------------------------------------------------------------*/
+struct search_result {
+    char **pats;            /* parsed patterns                          */
+    size_t pat_count;
+    size_t *pat_hits;       /* occurrences per pattern                  */
+    size_t *jump;           /* 0-based indices of lines with a hit      */
+    size_t jump_count;
+};
+
+extern struct search_result last_search;
+
+int  search_run(const char *query);     /* query without leading '/' */
+int  search_run_regex(const char *re);  /* regex without leading '?' */
+void search_jump(int dir);              /* +1 next hit, -1 previous  */
+void search_buffer_changed(void);       /* called on every edit      */
+void search_clear(void);
+
+/* Per-buffer state (buffer.c): each buffer keeps its last query, so n/N
+   carry on where they were after switching back */
+void *search_park(void);
+void search_unpark(void *state);
+
+#endif /* SEARCH_H */
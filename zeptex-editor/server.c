@@ -0,0 +1,213 @@
+#define _GNU_SOURCE         // struct ucred
+#include "editor.h"
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static int stop_fd = -1;            // signalfd for SIGINT and SIGTERM
+static volatile sig_atomic_t client_resized = 0;
+
+const char *server_default_socket(void) {
+    static char path[108];
+    const char *run = getenv("XDG_RUNTIME_DIR");
+    if (run && run[0] == '/' && strlen(run) + sizeof("/zeptex.sock") <= sizeof(path))
+        snprintf(path, sizeof(path), "%s/zeptex.sock", run);
+    else
+        snprintf(path, sizeof(path), "/tmp/zeptex-%u.sock", (unsigned)getuid());
+    return path;
+}
+
+// Whether the process at the other end of fd runs as our user
+static int same_user(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == getuid();
+}
+
+static int socket_addr(const char *sock_path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, sock_path);
+    return 0;
+}
+
+// Server
+
+int server_signals(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1) return -1;
+    stop_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    return stop_fd < 0 ? -1 : 0;
+}
+
+// Listen on sock_path, replacing a stale socket nobody answers on; the
+// socket is made 0600 before listening, so only our user can connect
+static int server_listen(const char *sock_path) {
+    struct sockaddr_un addr;
+    if (socket_addr(sock_path, &addr) < 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    mode_t mask = umask(077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    if (bound < 0 && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        int alive = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (alive) {
+            umask(mask);
+            errno = EADDRINUSE;
+            close(fd);
+            return -1;
+        }
+        unlink(sock_path);
+        bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    }
+    umask(mask);
+    if (bound < 0 || chmod(sock_path, 0600) < 0 || listen(fd, 4) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const char *sock_path, const char *filename) {
+    int lfd = server_listen(sock_path);
+    if (lfd < 0) {
+        fprintf(stderr, "zeptex: cannot listen on %s: %s\n", sock_path, strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "zeptex: serving %s on %s\n", filename ? filename : "(no file)", sock_path);
+
+    signal(SIGPIPE, SIG_IGN);           // a client may vanish mid-frame
+    set_stop_fd(stop_fd);               // SIGINT or SIGTERM ends a session too
+
+    int null_fd = open("/dev/null", O_RDWR);
+    for (;;) {
+        struct pollfd pfd[2] = {
+            { .fd = lfd, .events = POLLIN },
+            { .fd = stop_fd, .events = POLLIN }
+        };
+        if (poll(pfd, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (pfd[1].revents & POLLIN) break;
+        int conn = accept(lfd, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) continue;
+            break;
+        }
+        if (!same_user(conn)) {
+            fprintf(stderr, "zeptex: refused a client running as another user\n");
+            close(conn);
+            continue;
+        }
+
+        // The session's keys come from the socket and frames go back to it
+        fflush(stdout);
+        dup2(conn, STDIN_FILENO);
+        dup2(conn, STDOUT_FILENO);
+        close(conn);
+        set_window_size(24, 80);        // until the client reports its own
+
+        run_editor();
+
+        fflush(stdout);
+        clearerr(stdout);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+    }
+
+    close(lfd);
+    if (null_fd >= 0) close(null_fd);
+    unlink(sock_path);
+    return 0;
+}
+
+// Client
+
+static void handle_client_resize(int sig) {
+    (void)sig;
+    client_resized = 1;
+}
+
+static int send_size(int fd) {
+    struct winsize w;
+    char msg[32];
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) return 0;
+    int len = snprintf(msg, sizeof(msg), "\033[8;%u;%ut", w.ws_row, w.ws_col);
+    return write(fd, msg, (size_t)len) == len ? 0 : -1;
+}
+
+// Copy what is readable on from to to, 0 at end of input
+static int relay(int from, int to) {
+    char buf[65536];
+    ssize_t n = read(from, buf, sizeof(buf));
+    if (n < 0) return errno == EINTR || errno == EAGAIN ? 1 : 0;
+    for (ssize_t done = 0; done < n;) {
+        ssize_t w = write(to, buf + done, (size_t)(n - done));
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return 0;
+        done += w;
+    }
+    return n > 0;
+}
+
+int client_run(const char *sock_path) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || socket_addr(sock_path, &addr) < 0 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "zeptex: no server on %s: %s\n", sock_path, strerror(errno));
+        return 1;
+    }
+    if (!same_user(fd)) {
+        fprintf(stderr, "zeptex: the server on %s runs as another user\n", sock_path);
+        close(fd);
+        return 1;
+    }
+
+    struct sigaction sa = { .sa_handler = handle_client_resize, .sa_flags = 0 };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+
+    printf("\033[?1049h\033[?25l");
+    fflush(stdout);
+    enable_raw_mode();
+    send_size(fd);
+
+    for (;;) {
+        if (client_resized) {
+            client_resized = 0;
+            send_size(fd);
+        }
+        struct pollfd pfd[2] = {
+            { .fd = STDIN_FILENO, .events = POLLIN },
+            { .fd = fd, .events = POLLIN }
+        };
+        if (poll(pfd, 2, -1) == -1) continue;   // EINTR: resize
+        if (pfd[1].revents & (POLLIN | POLLHUP) && !relay(fd, STDOUT_FILENO)) break;
+        if (pfd[0].revents & (POLLIN | POLLHUP) && !relay(STDIN_FILENO, fd)) break;
+    }
+
+    close(fd);
+    disable_raw_mode();
+    printf("\033[?1049l\033[?25h");
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/* server.h - keep the editor resident behind a Unix domain socket
+   "--server" loads the file once and then serves editing sessions: each
+   client connection becomes run_editor's input and output, so a client
+   sends keystrokes in the usual command grammar and receives rendered
+   frames.  "--client" is the thin terminal side: it relays raw bytes and
+   reports the terminal size in-band as ESC [ 8 ; rows ; cols t.  Quitting
+   a session leaves the server, and the loaded buffer, running.
+
+   The socket lives in $XDG_RUNTIME_DIR when that is set, else in /tmp.
+   It is created 0600, and a connection from a process of another user
+   is refused (SO_PEERCRED), as is a server of another user on the
+   client side.  SIGINT and SIGTERM stop the server, also while a client
+   is attached.
+*/
+#ifndef SERVER_H
+#define SERVER_H
+
+const char *server_default_socket(void);   /* $XDG_RUNTIME_DIR/zeptex.sock
+                                              or /tmp/zeptex-UID.sock    */
+int server_signals(void);                   /* before any thread starts  */
+int server_run(const char *sock_path, const char *filename);
+int client_run(const char *sock_path);      /* exit status for main()    */
+
+#endif /* SERVER_H */
@@ -0,0 +1,237 @@
+#define _GNU_SOURCE         // fopencookie, mallinfo2
+#include "editor.h"
+#include "buffer.h"
+#include "follow.h"
+#include "stats.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STATS_ROWS 16       // lines written by "stats"
+
+// Output and allocations are only counted when built with ZEPTEX_STATS
+#if defined(ZEPTEX_STATS) && defined(__GLIBC__) && \
+    !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+#define ALLOC_COUNT
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#undef ALLOC_COUNT
+#endif
+#endif
+#endif
+
+static struct {
+    int overlay;
+    uint64_t start;                 // ns, at stats_init
+    uint64_t keys, key_at;          // key_at: ns of the first key not yet drawn
+    uint64_t frames, frame_ns, frame_max, frame_start, bytes_at_start, skipped;
+    uint64_t last_ns, last_bytes, last_latency;
+    uint64_t latency_ns, latencies;
+    uint64_t bytes_out, writes;
+    uint64_t edits;
+    uint64_t io_start;
+    uint64_t loads, load_bytes, load_ns;
+    uint64_t saves, save_bytes, save_ns;
+    size_t allocs_shown;            // allocation count at the last overlay
+} st;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Allocation counting
+
+#ifdef ALLOC_COUNT
+static size_t allocs, frees;        // from any thread, updated atomically
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+extern void __libc_free(void *p);
+
+void *malloc(size_t n) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    if (!p) __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, n);
+}
+
+void free(void *p) {
+    if (p) __atomic_add_fetch(&frees, 1, __ATOMIC_RELAXED);
+    __libc_free(p);
+}
+#endif
+
+// Counting stdout
+
+#ifdef ZEPTEX_STATS
+static ssize_t counted_write(void *cookie, const char *buf, size_t len) {
+    (void)cookie;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(STDOUT_FILENO, buf + done, len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return done ? (ssize_t)done : -1;
+        done += (size_t)n;
+    }
+    st.bytes_out += done;
+    st.writes++;
+    return (ssize_t)done;
+}
+#endif
+
+// Public interface
+
+void stats_init(void) {
+    st.start = now_ns();
+#ifdef ZEPTEX_STATS
+    cookie_io_functions_t io = { NULL, counted_write, NULL, NULL };
+    FILE *counted = fopencookie(NULL, "w", io);
+    if (!counted) return;
+    fflush(stdout);
+    setvbuf(counted, NULL, _IOFBF, 1 << 16);   // as main() sets stdout
+    stdout = counted;
+#endif
+}
+
+void stats_key(void) {
+    st.keys++;
+    if (!st.key_at) st.key_at = now_ns();
+}
+
+void stats_frame_start(void) {
+    st.frame_start = now_ns();
+    st.bytes_at_start = st.bytes_out;
+}
+
+void stats_frame_end(void) {
+    uint64_t now = now_ns();
+    st.last_ns = now - st.frame_start;
+    st.last_bytes = st.bytes_out - st.bytes_at_start;
+    st.frames++;
+    st.frame_ns += st.last_ns;
+    if (st.last_ns > st.frame_max) st.frame_max = st.last_ns;
+    if (st.key_at) {
+        st.last_latency = now - st.key_at;
+        st.latency_ns += st.last_latency;
+        st.latencies++;
+        st.key_at = 0;
+    }
+}
+
+void stats_frame_skipped(void) {
+    st.skipped++;
+}
+
+void stats_edit(size_t lines) {
+    st.edits += lines;
+}
+
+void stats_io_start(void) {
+    st.io_start = now_ns();
+}
+
+void stats_io_end(int save, size_t bytes) {
+    uint64_t ns = now_ns() - st.io_start;
+    if (save) {
+        st.saves++;
+        st.save_bytes += bytes;
+        st.save_ns += ns;
+    } else {
+        st.loads++;
+        st.load_bytes += bytes;
+        st.load_ns += ns;
+    }
+}
+
+// Figures of the frame before this one
+void stats_overlay(int cols) {
+    if (!st.overlay) return;
+    struct mallinfo2 mi = mallinfo2();
+    char row[256];
+    int n = snprintf(row, sizeof(row), "frame %.2f ms", st.last_ns / 1e6);
+#ifdef ZEPTEX_STATS
+    n += snprintf(row + n, sizeof(row) - (size_t)n, ", %.1f KB", st.last_bytes / 1024.0);
+#endif
+    n += snprintf(row + n, sizeof(row) - (size_t)n,
+                  " | key to frame %.2f ms | heap %.1f MB | %zu lines",
+                  st.last_latency / 1e6, (mi.uordblks + mi.hblkhd) / 1048576.0, line_count);
+#ifdef ALLOC_COUNT
+    size_t now = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+    snprintf(row + n, sizeof(row) - (size_t)n, " | %zu allocs (+%zu)", now, now - st.allocs_shown);
+    st.allocs_shown = now;
+#endif
+    printf("\033[2m%.*s\033[0m", cols > 0 ? cols : 0, row);
+}
+
+static double mb_per_s(uint64_t bytes, uint64_t ns) {
+    return ns ? bytes * 1e3 / ns : 0.0;
+}
+
+void stats_command(const char *arg) {
+    while (*arg == ' ') arg++;
+    if (strcmp(arg, "on") == 0 || strcmp(arg, "off") == 0) {
+        st.overlay = arg[1] == 'n';
+        set_status("stats overlay %s", arg);
+        return;
+    }
+    if (*arg) {
+        set_status("Use: stats [on|off]");
+        return;
+    }
+    if (follow_fd() >= 0) {
+        set_status("Only one buffer in follow mode");
+        return;
+    }
+
+    // Taken before switching: filling the scratch buffer is itself an edit
+    size_t text = 0;
+    for (size_t i = 0; i < line_count; ++i) text += strlen(lines[i]) + 1;
+    struct mallinfo2 mi = mallinfo2();
+    char row[STATS_ROWS][128];
+    int n = 0;
+    snprintf(row[n++], 128, "uptime        %.1f s", (now_ns() - st.start) / 1e9);
+    snprintf(row[n++], 128, "keys          %llu", (unsigned long long)st.keys);
+    snprintf(row[n++], 128, "frames        %llu, %.2f ms average, %.2f ms slowest, %llu skipped",
+             (unsigned long long)st.frames, st.frames ? st.frame_ns / 1e6 / st.frames : 0.0,
+             st.frame_max / 1e6, (unsigned long long)st.skipped);
+#ifdef ZEPTEX_STATS
+    snprintf(row[n++], 128, "output        %.2f MB in %llu writes, %.1f KB per frame",
+             st.bytes_out / 1048576.0, (unsigned long long)st.writes,
+             st.frames ? st.bytes_out / 1024.0 / st.frames : 0.0);
+#endif
+    snprintf(row[n++], 128, "key to frame  %.2f ms average, %.2f ms last",
+             st.latencies ? st.latency_ns / 1e6 / st.latencies : 0.0, st.last_latency / 1e6);
+    snprintf(row[n++], 128, "edits         %llu lines", (unsigned long long)st.edits);
+    snprintf(row[n++], 128, "loads         %llu, %.2f MB in %.1f ms, %.1f MB/s",
+             (unsigned long long)st.loads, st.load_bytes / 1048576.0, st.load_ns / 1e6,
+             mb_per_s(st.load_bytes, st.load_ns));
+    snprintf(row[n++], 128, "saves         %llu, %.2f MB in %.1f ms, %.1f MB/s",
+             (unsigned long long)st.saves, st.save_bytes / 1048576.0, st.save_ns / 1e6,
+             mb_per_s(st.save_bytes, st.save_ns));
+    snprintf(row[n++], 128, "buffer        %zu lines, %.2f MB of text", line_count,
+             text / 1048576.0);
+    snprintf(row[n++], 128, "heap          %.2f MB in use", (mi.uordblks + mi.hblkhd) / 1048576.0);
+#ifdef ALLOC_COUNT
+    snprintf(row[n++], 128, "allocations   %zu, %zu freed",
+             __atomic_load_n(&allocs, __ATOMIC_RELAXED), __atomic_load_n(&frees, __ATOMIC_RELAXED));
+#endif
+
+    if (buffer_scratch("[stats]") < 0) return;
+    for (int i = 0; i < n; ++i) insert_line(line_count + 1, row[i]);
+    buffer_dirty = 0;
+    scroll_offset = 0;
+}
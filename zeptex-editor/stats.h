@@ -0,0 +1,39 @@
+/* stats.h - performance counters, an overlay and the stats command
+   Keys, frames, edits, loads and saves are counted as they happen.
+   Built with ZEPTEX_STATS (make STATS=1), bytes sent to the terminal
+   are counted too, by routing stdout through a counting stream that
+   writes to the same descriptor, fully buffered so that a frame goes
+   out in one write; and allocations, by wrapping malloc and friends
+   around glibc's own (except in sanitizer builds, which wrap them
+   already).  Other builds, the benchmarks among them, keep the plain
+   stdout and allocator.
+
+   "stats on" shows the last frame's figures in the blank row under the
+   title, "stats off" hides them again, and "stats" writes the totals
+   into a scratch buffer, [stats], which can be scrolled or saved.
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>   /* for size_t */
+
+void stats_init(void);                  /* before anything is printed */
+
+/*--------------------------------------------------------------------
+  Hooks
+ --------------------------------------------------------------------*/
+void stats_key(void);                   /* a key was read            */
+void stats_frame_start(void);
+void stats_frame_end(void);             /* after the frame's fflush  */
+void stats_frame_skipped(void);         /* merged into a later frame */
+void stats_edit(size_t lines);          /* lines inserted or deleted */
+void stats_io_start(void);
+void stats_io_end(int save, size_t bytes);      /* load_file, save_file */
+
+/*--------------------------------------------------------------------
+  Display
+ --------------------------------------------------------------------*/
+void stats_overlay(int cols);           /* the row under the title   */
+void stats_command(const char *arg);    /* "", " on" or " off"       */
+
+#endif /* STATS_H */
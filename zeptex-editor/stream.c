@@ -0,0 +1,190 @@
+#include "stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STREAM_WBUF 65536
+#define STREAM_RBUF (1 << 20)   // bytes decoded per read by stream_getline
+
+static const struct stream_backend *backends[] = { &stream_gzip, &stream_plain };
+
+// Plain files
+
+static int plain_open_read(struct stream *s) {
+    struct stat st;
+    if (fstat(s->fd, &st) < 0) return -1;
+    s->size = st.st_size;
+    s->size_exact = 1;
+    return 0;
+}
+
+static int plain_open_write(struct stream *s) {
+    (void)s;
+    return 0;
+}
+
+static ssize_t plain_pread(struct stream *s, void *buf, size_t n, off_t off) {
+    ssize_t r;
+    do r = pread(s->fd, buf, n, off);
+    while (r < 0 && errno == EINTR);
+    return r;
+}
+
+static ssize_t plain_write(struct stream *s, const void *buf, size_t n) {
+    for (size_t done = 0; done < n;) {
+        ssize_t r = write(s->fd, (const char *)buf + done, n - done);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+        done += (size_t)r;
+    }
+    return (ssize_t)n;
+}
+
+static int plain_close(struct stream *s) {
+    (void)s;
+    return 0;
+}
+
+const struct stream_backend stream_plain = {
+    "plain", NULL, NULL,
+    plain_open_read, plain_open_write, plain_pread, plain_write, plain_close, NULL
+};
+
+// Backend selection
+
+static const struct stream_backend *detect_backend(int fd) {
+    unsigned char magic[8];
+    ssize_t n = pread(fd, magic, sizeof(magic), 0);
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i)
+        if (backends[i]->detect && n > 0 && backends[i]->detect(magic, (size_t)n))
+            return backends[i];
+    return &stream_plain;
+}
+
+static const struct stream_backend *backend_for_name(const char *path) {
+    size_t len = strlen(path);
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        const char *ext = backends[i]->extension;
+        if (ext && len > strlen(ext) && strcmp(path + len - strlen(ext), ext) == 0)
+            return backends[i];
+    }
+    return &stream_plain;
+}
+
+int stream_compressed(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    int compressed = detect_backend(fd) != &stream_plain;
+    close(fd);
+    return compressed;
+}
+
+// Public interface
+
+struct stream *stream_open(const char *path, int mode) {
+    struct stream *s = calloc(1, sizeof(*s));
+    if (!s) return NULL;
+
+    if (mode == STREAM_WRITE) {
+        s->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        s->backend = backend_for_name(path);
+        s->wbuf = malloc(STREAM_WBUF);
+        if (s->fd >= 0 && s->wbuf && s->backend->open_write(s) == 0) return s;
+    } else {
+        s->fd = open(path, O_RDONLY);
+        if (s->fd >= 0) {
+            s->backend = detect_backend(s->fd);
+            if (s->backend->open_read(s) == 0) return s;
+        }
+    }
+
+    int err = errno;
+    if (s->fd >= 0) close(s->fd);
+    free(s->wbuf);
+    free(s);
+    errno = err;
+    return NULL;
+}
+
+ssize_t stream_pread(struct stream *s, void *buf, size_t n, off_t off) {
+    return s->backend->pread(s, buf, n, off);
+}
+
+ssize_t stream_read(struct stream *s, void *buf, size_t n) {
+    ssize_t r = s->backend->pread(s, buf, n, s->pos);
+    if (r > 0) s->pos += r;
+    return r;
+}
+
+// Next line without its newline, NULL at the end of the input; a last
+// line without a newline is returned as well
+char *stream_getline(struct stream *s, size_t *len) {
+    char *line = NULL;
+    size_t n = 0;
+    for (;;) {
+        if (s->rpos == s->rlen) {
+            if (!s->rbuf && !(s->rbuf = malloc(STREAM_RBUF))) {
+                s->rerr = ENOMEM;
+                break;
+            }
+            ssize_t r = stream_read(s, s->rbuf, STREAM_RBUF);
+            if (r < 0) s->rerr = errno ? errno : EIO;
+            if (r <= 0) break;
+            s->rpos = 0;
+            s->rlen = (size_t)r;
+        }
+        char *p = s->rbuf + s->rpos;
+        char *nl = memchr(p, '\n', s->rlen - s->rpos);
+        size_t take = nl ? (size_t)(nl - p) : s->rlen - s->rpos;
+        char *grown = realloc(line, n + take + 1);
+        if (!grown) {
+            free(line);
+            s->rerr = ENOMEM;
+            return NULL;
+        }
+        line = grown;
+        memcpy(line + n, p, take);
+        n += take;
+        line[n] = '\0';
+        s->rpos += take + (nl != NULL);
+        if (nl) break;
+    }
+    if (len) *len = n;
+    return line;
+}
+
+off_t stream_size(struct stream *s, int *exact) {
+    if (s->backend->size) return s->backend->size(s, exact);
+    *exact = s->size_exact;
+    return s->size;
+}
+
+static void stream_flush(struct stream *s) {
+    if (s->wlen && s->backend->write(s, s->wbuf, s->wlen) < 0) s->werr = 1;
+    s->wlen = 0;
+}
+
+ssize_t stream_write(struct stream *s, const void *buf, size_t n) {
+    if (s->wlen + n > STREAM_WBUF) stream_flush(s);
+    if (n >= STREAM_WBUF) {
+        if (s->backend->write(s, buf, n) < 0) s->werr = 1;
+    } else {
+        memcpy(s->wbuf + s->wlen, buf, n);
+        s->wlen += n;
+    }
+    return s->werr ? -1 : (ssize_t)n;
+}
+
+int stream_close(struct stream *s) {
+    if (s->wbuf) stream_flush(s);
+    int failed = s->backend->close(s) < 0 || s->werr;
+    if (s->fd >= 0 && close(s->fd) < 0) failed = 1;
+    free(s->wbuf);
+    free(s->rbuf);
+    free(s);
+    return failed ? -1 : 0;
+}
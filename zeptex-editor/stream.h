@@ -0,0 +1,63 @@
+/* stream.h - pluggable byte streams behind load_file/save_file/pager
+   A backend is picked by the file's magic bytes when reading and by its
+   extension when writing.  Reads are positional, so the pager can ask
+   for any offset of the decoded data; compressed backends keep seek
+   points to make that cheap.  Backends: plain files and gzip (zlib).
+*/
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stddef.h>   /* for size_t */
+#include <sys/types.h>
+
+struct stream;
+
+/*--------------------------------------------------------------------
+  Backend definition
+ --------------------------------------------------------------------*/
+struct stream_backend {
+    const char *name;
+    const char *extension;              /* chosen for writing, or NULL */
+    int (*detect)(const unsigned char *magic, size_t n);
+    int (*open_read)(struct stream *s);
+    int (*open_write)(struct stream *s);
+    ssize_t (*pread)(struct stream *s, void *buf, size_t n, off_t off);
+    ssize_t (*write)(struct stream *s, const void *buf, size_t n);
+    int (*close)(struct stream *s);
+    off_t (*size)(struct stream *s, int *exact);    /* NULL: the fields */
+};
+
+extern const struct stream_backend stream_plain;
+extern const struct stream_backend stream_gzip;
+
+struct stream {
+    const struct stream_backend *backend;
+    int fd;
+    off_t pos;              /* next stream_read() offset               */
+    off_t size;             /* decoded size, or a guess if !size_exact; */
+    int size_exact;         /* read them through stream_size()         */
+    void *ctx;              /* private to the backend                  */
+    unsigned char *wbuf;    /* stream_write() buffer                   */
+    size_t wlen;
+    int werr;               /* a write failed                          */
+    char *rbuf;             /* stream_getline() buffer                 */
+    size_t rpos, rlen;
+    int rerr;               /* errno that cut stream_getline() short   */
+};
+
+/*--------------------------------------------------------------------
+  Interface
+ --------------------------------------------------------------------*/
+enum { STREAM_READ, STREAM_WRITE };
+
+struct stream *stream_open(const char *path, int mode);
+ssize_t stream_read(struct stream *s, void *buf, size_t n);
+char *stream_getline(struct stream *s, size_t *len);   /* buffered; caller frees */
+ssize_t stream_pread(struct stream *s, void *buf, size_t n, off_t off);
+ssize_t stream_write(struct stream *s, const void *buf, size_t n);
+off_t stream_size(struct stream *s, int *exact);
+int stream_close(struct stream *s);     /* -1 if a write failed */
+
+int stream_compressed(const char *path); /* 1 unless plain bytes */
+
+#endif /* STREAM_H */
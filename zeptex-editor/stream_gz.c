@@ -0,0 +1,285 @@
+#include "stream.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define GZ_WINDOW     32768             // deflate history a seek point needs
+#define GZ_INBUF      65536
+#define GZ_MIN_SPAN   (1 << 20)         // decoded bytes between seek points
+#define GZ_MAX_POINTS 1024              // span grows with the file to keep this
+
+// Decoding resumes from a seek point: a deflate block boundary with the
+// 32 KB of output before it, as in zlib's examples/zran.c
+struct gz_point {
+    off_t out;              // decoded offset
+    off_t in;               // compressed offset of the first full byte
+    int bits;               // bits of the byte before it still unread
+    unsigned window_len;
+    unsigned char window[GZ_WINDOW];
+};
+
+// A decoder positioned somewhere in the stream; two of them are kept so
+// a sequential reader (load_file, the pager's indexer) and the pager's
+// random reads do not keep throwing each other's state away
+struct gz_cursor {
+    z_stream zs;
+    int live;
+    int raw;                // started at a seek point, no gzip header
+    off_t out;              // decoded offset of the next output byte
+    off_t in;               // compressed offset of the next input read
+    unsigned long used;     // for least-recently-used replacement
+    unsigned char inbuf[GZ_INBUF];
+};
+
+struct gz_ctx {
+    pthread_mutex_t lock;   // the pager reads from two threads
+    struct gz_point *points;
+    size_t count, cap;
+    off_t span;
+    off_t csize;            // compressed size, for estimating the decoded one
+    struct gz_cursor cur[2];
+    unsigned long clock;
+    unsigned char discard[GZ_WINDOW];   // output skipped on the way to off
+    z_stream def;           // writer
+};
+
+// Reading
+
+static int gz_detect(const unsigned char *magic, size_t n) {
+    return n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+static int gz_open_read(struct stream *s) {
+    struct gz_ctx *g = calloc(1, sizeof(*g));
+    if (!g) return -1;
+    pthread_mutex_init(&g->lock, NULL);
+    s->ctx = g;
+
+    // The trailer holds the decoded size mod 2^32 (of the last member);
+    // take the smallest value that is not below the compressed size
+    // until decoding gives a better estimate
+    struct stat st;
+    off_t csize = g->csize = fstat(s->fd, &st) == 0 ? st.st_size : 0;
+    unsigned char trailer[4];
+    s->size = 0;
+    if (csize >= 18 && pread(s->fd, trailer, 4, csize - 4) == 4) {
+        off_t isize = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (off_t)trailer[3] << 24;
+        while (isize < csize) isize += (off_t)1 << 32;
+        s->size = isize;
+    }
+    s->size_exact = 0;
+    g->span = s->size / GZ_MAX_POINTS > GZ_MIN_SPAN ? s->size / GZ_MAX_POINTS : GZ_MIN_SPAN;
+    return 0;
+}
+
+static void cursor_end(struct gz_cursor *c) {
+    if (c->live) inflateEnd(&c->zs);
+    c->live = 0;
+}
+
+// Start c at seek point p, or at the beginning of the file
+static int cursor_seat(struct stream *s, struct gz_cursor *c, const struct gz_point *p) {
+    cursor_end(c);
+    memset(&c->zs, 0, sizeof(c->zs));
+    if (inflateInit2(&c->zs, p ? -15 : 31) != Z_OK) return -1;
+    c->live = 1;
+    c->raw = p != NULL;
+    c->out = p ? p->out : 0;
+    c->in = p ? p->in : 0;
+    if (p && p->bits) {
+        unsigned char byte;
+        if (pread(s->fd, &byte, 1, p->in - 1) != 1) return -1;
+        inflatePrime(&c->zs, p->bits, byte >> (8 - p->bits));
+    }
+    if (p) inflateSetDictionary(&c->zs, p->window, p->window_len);
+    return 0;
+}
+
+static int cursor_fill(struct stream *s, struct gz_cursor *c) {
+    ssize_t n;
+    do n = pread(s->fd, c->inbuf, sizeof(c->inbuf), c->in);
+    while (n < 0 && errno == EINTR);
+    if (n <= 0) return 0;
+    c->in += n;
+    c->zs.next_in = c->inbuf;
+    c->zs.avail_in = (uInt)n;
+    return 1;
+}
+
+static void add_point(struct gz_ctx *g, struct gz_cursor *c) {
+    if (g->count && c->out - g->points[g->count - 1].out < g->span) return;
+    if (g->count == g->cap) {
+        size_t cap = g->cap ? g->cap * 2 : 16;
+        struct gz_point *grown = realloc(g->points, cap * sizeof(*grown));
+        if (!grown) return;
+        g->points = grown;
+        g->cap = cap;
+    }
+    struct gz_point *p = &g->points[g->count];
+    p->out = c->out;
+    p->in = c->in - c->zs.avail_in;
+    p->bits = c->zs.data_type & 7;
+    p->window_len = GZ_WINDOW;
+    if (inflateGetDictionary(&c->zs, p->window, &p->window_len) == Z_OK) g->count++;
+}
+
+// At the end of a member: continue with the next one, 0 at end of file
+static int next_member(struct stream *s, struct gz_cursor *c) {
+    for (int skip = c->raw ? 8 : 0; skip > 0;) {  // trailer, unread in raw mode
+        if (!c->zs.avail_in && !cursor_fill(s, c)) return 0;
+        uInt take = c->zs.avail_in < (uInt)skip ? c->zs.avail_in : (uInt)skip;
+        c->zs.next_in += take;
+        c->zs.avail_in -= take;
+        skip -= (int)take;
+    }
+    if (!c->zs.avail_in && !cursor_fill(s, c)) return 0;
+    c->raw = 0;
+    return inflateReset2(&c->zs, 31) == Z_OK;
+}
+
+// Decode from c up to off, then up to n bytes into buf
+static ssize_t cursor_read(struct stream *s, struct gz_cursor *c, off_t off,
+                           unsigned char *buf, size_t n) {
+    struct gz_ctx *g = s->ctx;
+    size_t got = 0;
+    while (got < n) {
+        if (!c->zs.avail_in && !cursor_fill(s, c)) break;
+
+        int skipping = c->out < off;
+        size_t room = skipping ? (size_t)(off - c->out) : n - got;
+        if (skipping && room > sizeof(g->discard)) room = sizeof(g->discard);
+        if (room > UINT_MAX) room = UINT_MAX;
+        c->zs.next_out = skipping ? g->discard : buf + got;
+        c->zs.avail_out = (uInt)room;
+
+        int ret = inflate(&c->zs, Z_BLOCK);
+        size_t made = room - c->zs.avail_out;
+        c->out += (off_t)made;
+        if (!skipping) got += made;
+
+        if (ret == Z_STREAM_END) {
+            if (!next_member(s, c)) break;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            cursor_end(c);      // corrupt data or trailing garbage: stop here
+            break;
+        } else if ((c->zs.data_type & 128) && !(c->zs.data_type & 64)) {
+            add_point(g, c);
+        }
+    }
+    if (got < n && (!c->live || !c->zs.avail_in)) {
+        s->size = c->out;       // reached the end, now the size is known
+        s->size_exact = 1;
+    } else if (!s->size_exact) {
+        off_t used = c->in - (off_t)c->zs.avail_in;
+        if (used >= GZ_MIN_SPAN || c->out > s->size)
+            s->size = (off_t)((double)c->out * ((double)g->csize / (double)used));
+    }
+    return (ssize_t)got;
+}
+
+static ssize_t gz_pread(struct stream *s, void *buf, size_t n, off_t off) {
+    struct gz_ctx *g = s->ctx;
+    pthread_mutex_lock(&g->lock);
+
+    // Nearest seek point at or before off
+    const struct gz_point *p = NULL;
+    size_t lo = 0, hi = g->count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (g->points[mid].out <= off) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo) p = &g->points[lo - 1];
+
+    // Use a cursor that can get to off without passing a seek point,
+    // else restart the least recently used one from the seek point
+    struct gz_cursor *c = NULL;
+    for (int i = 0; i < 2; ++i) {
+        struct gz_cursor *t = &g->cur[i];
+        if (t->live && t->out <= off && (!c || t->out > c->out)) c = t;
+    }
+    if (!c || (p && c->out < p->out)) {
+        c = g->cur[0].used <= g->cur[1].used ? &g->cur[0] : &g->cur[1];
+        if (cursor_seat(s, c, p) < 0) {
+            cursor_end(c);
+            pthread_mutex_unlock(&g->lock);
+            return -1;
+        }
+    }
+    c->used = ++g->clock;
+
+    ssize_t got = cursor_read(s, c, off, buf, n);
+    pthread_mutex_unlock(&g->lock);
+    return got;
+}
+
+static off_t gz_size(struct stream *s, int *exact) {
+    struct gz_ctx *g = s->ctx;
+    pthread_mutex_lock(&g->lock);
+    off_t size = s->size;
+    *exact = s->size_exact;
+    pthread_mutex_unlock(&g->lock);
+    return size;
+}
+
+// Writing
+
+static int gz_open_write(struct stream *s) {
+    struct gz_ctx *g = calloc(1, sizeof(*g));
+    if (!g) return -1;
+    s->ctx = g;
+    if (deflateInit2(&g->def, 6, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(g);
+        s->ctx = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int gz_deflate(struct stream *s, const void *buf, size_t n, int flush) {
+    struct gz_ctx *g = s->ctx;
+    unsigned char out[GZ_INBUF];
+    g->def.next_in = (unsigned char *)buf;
+    g->def.avail_in = (uInt)n;
+    int ret;
+    do {
+        g->def.next_out = out;
+        g->def.avail_out = sizeof(out);
+        ret = deflate(&g->def, flush);
+        if (ret == Z_STREAM_ERROR) return -1;
+        if (stream_plain.write(s, out, sizeof(out) - g->def.avail_out) < 0) return -1;
+    } while (g->def.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+    return 0;
+}
+
+static ssize_t gz_write(struct stream *s, const void *buf, size_t n) {
+    return gz_deflate(s, buf, n, Z_NO_FLUSH) < 0 ? -1 : (ssize_t)n;
+}
+
+static int gz_close(struct stream *s) {
+    struct gz_ctx *g = s->ctx;
+    if (!g) return 0;
+    int ret = 0;
+    if (g->def.state) {
+        ret = gz_deflate(s, NULL, 0, Z_FINISH);
+        deflateEnd(&g->def);
+    } else {
+        cursor_end(&g->cur[0]);
+        cursor_end(&g->cur[1]);
+        free(g->points);
+        pthread_mutex_destroy(&g->lock);
+    }
+    free(g);
+    return ret;
+}
+
+const struct stream_backend stream_gzip = {
+    "gzip", ".gz", gz_detect,
+    gz_open_read, gz_open_write, gz_pread, gz_write, gz_close, gz_size
+};
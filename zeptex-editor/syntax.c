@@ -0,0 +1,844 @@
+#include "syntax.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SYN_MAX_STATES 65535
+
+// Thompson NFA, one per lexer mode
+
+enum { N_SET, N_SPLIT, N_EPS, N_MATCH };
+
+struct nfa_state {
+    unsigned char type;
+    int out, out1;              // -1 while dangling
+    int rule;                   // N_MATCH only
+    uint32_t set[8];            // N_SET only: accepted bytes
+};
+
+struct nfa {
+    struct nfa_state *st;
+    size_t count, cap;
+    int *starts;                // first state of every rule
+    unsigned char *anchored;    // rule only matches at column 0
+    size_t start_count, start_cap;
+};
+
+struct frag {
+    int start, end;             // end is an N_SET or N_EPS with out == -1
+};
+
+static int nfa_add(struct nfa *n, unsigned char type) {
+    if (n->count == n->cap) {
+        size_t cap = n->cap ? n->cap * 2 : 256;
+        struct nfa_state *st = realloc(n->st, cap * sizeof(*st));
+        if (!st) return -1;
+        n->st = st;
+        n->cap = cap;
+    }
+    struct nfa_state *s = &n->st[n->count];
+    memset(s, 0, sizeof(*s));
+    s->type = type;
+    s->out = s->out1 = -1;
+    return (int)n->count++;
+}
+
+static void nfa_free(struct nfa *n) {
+    free(n->st);
+    free(n->starts);
+    free(n->anchored);
+    memset(n, 0, sizeof(*n));
+}
+
+static void set_add(uint32_t *set, unsigned c) {
+    set[c >> 5] |= 1u << (c & 31);
+}
+
+static int set_has(const uint32_t *set, unsigned c) {
+    return (set[c >> 5] >> (c & 31)) & 1;
+}
+
+static void set_range(uint32_t *set, unsigned lo, unsigned hi) {
+    for (unsigned c = lo; c <= hi; ++c) set_add(set, c);
+}
+
+// Regex parser (recursive descent straight to NFA fragments)
+
+struct re_parser {
+    const char *p;
+    struct nfa *nfa;
+    const char *err;
+};
+
+static int re_alt(struct re_parser *rp, struct frag *f);
+
+// \d \w \s \t \n, anything else stands for itself
+static void re_escape(char e, uint32_t *set) {
+    switch (e) {
+    case 'd': set_range(set, '0', '9'); break;
+    case 'w':
+        set_range(set, '0', '9');
+        set_range(set, 'A', 'Z');
+        set_range(set, 'a', 'z');
+        set_add(set, '_');
+        break;
+    case 's': set_add(set, ' '); set_add(set, '\t'); break;
+    case 't': set_add(set, '\t'); break;
+    case 'n': set_add(set, '\n'); break;
+    default:  set_add(set, (unsigned char)e); break;
+    }
+}
+
+static int re_class(struct re_parser *rp, uint32_t *set) {
+    const char *p = rp->p + 1;          // past '['
+    int negate = *p == '^';
+    if (negate) p++;
+    int first = 1;
+    while (*p && (*p != ']' || first)) {
+        first = 0;
+        unsigned lo = (unsigned char)*p;
+        if (*p == '\\' && p[1]) {
+            re_escape(p[1], set);
+            p += 2;
+            continue;
+        }
+        p++;
+        if (*p == '-' && p[1] && p[1] != ']') {
+            unsigned hi = (unsigned char)p[1];
+            if (hi < lo) {
+                rp->err = "bad range in [...]";
+                return -1;
+            }
+            set_range(set, lo, hi);
+            p += 2;
+        } else {
+            set_add(set, lo);
+        }
+    }
+    if (*p != ']') {
+        rp->err = "missing ]";
+        return -1;
+    }
+    rp->p = p + 1;
+    if (negate)
+        for (int i = 0; i < 8; ++i) set[i] = ~set[i];
+    set[0] &= ~1u;                      // never match the terminating NUL
+    return 0;
+}
+
+static int re_atom(struct re_parser *rp, struct frag *f) {
+    uint32_t set[8] = {0};
+    char c = *rp->p;
+
+    if (c == '(') {
+        rp->p++;
+        if (re_alt(rp, f) < 0) return -1;
+        if (*rp->p != ')') {
+            rp->err = "missing )";
+            return -1;
+        }
+        rp->p++;
+        return 0;
+    } else if (c == '[') {
+        if (re_class(rp, set) < 0) return -1;
+    } else if (c == '.') {
+        set_range(set, 1, 255);
+        rp->p++;
+    } else if (c == '\\' && rp->p[1]) {
+        re_escape(rp->p[1], set);
+        rp->p += 2;
+    } else if (c == '*' || c == '+' || c == '?') {
+        rp->err = "nothing to repeat";
+        return -1;
+    } else {
+        set_add(set, (unsigned char)c);
+        rp->p++;
+    }
+
+    int s = nfa_add(rp->nfa, N_SET);
+    if (s < 0) {
+        rp->err = "out of memory";
+        return -1;
+    }
+    memcpy(rp->nfa->st[s].set, set, sizeof(set));
+    f->start = f->end = s;
+    return 0;
+}
+
+static int re_repeat(struct re_parser *rp, struct frag *f) {
+    if (re_atom(rp, f) < 0) return -1;
+    for (char q = *rp->p; q == '*' || q == '+' || q == '?'; q = *++rp->p) {
+        int split = nfa_add(rp->nfa, N_SPLIT);
+        int end = nfa_add(rp->nfa, N_EPS);
+        if (split < 0 || end < 0) {
+            rp->err = "out of memory";
+            return -1;
+        }
+        struct nfa_state *st = rp->nfa->st;
+        st[split].out = f->start;
+        st[split].out1 = end;
+        st[f->end].out = q == '?' ? end : split;
+        f->start = q == '+' ? f->start : split;
+        f->end = end;
+    }
+    return 0;
+}
+
+static int re_concat(struct re_parser *rp, struct frag *f) {
+    int empty = nfa_add(rp->nfa, N_EPS);
+    if (empty < 0) {
+        rp->err = "out of memory";
+        return -1;
+    }
+    f->start = f->end = empty;
+    while (*rp->p && *rp->p != '|' && *rp->p != ')') {
+        struct frag g;
+        if (re_repeat(rp, &g) < 0) return -1;
+        rp->nfa->st[f->end].out = g.start;
+        f->end = g.end;
+    }
+    return 0;
+}
+
+static int re_alt(struct re_parser *rp, struct frag *f) {
+    if (re_concat(rp, f) < 0) return -1;
+    while (*rp->p == '|') {
+        rp->p++;
+        struct frag g;
+        if (re_concat(rp, &g) < 0) return -1;
+        int split = nfa_add(rp->nfa, N_SPLIT);
+        int end = nfa_add(rp->nfa, N_EPS);
+        if (split < 0 || end < 0) {
+            rp->err = "out of memory";
+            return -1;
+        }
+        struct nfa_state *st = rp->nfa->st;
+        st[split].out = f->start;
+        st[split].out1 = g.start;
+        st[f->end].out = end;
+        st[g.end].out = end;
+        f->start = split;
+        f->end = end;
+    }
+    return 0;
+}
+
+// Terminate frag with a match of rule and make it a start of the mode
+static const char *nfa_finish(struct nfa *n, struct frag f, int rule, int anchored) {
+    int m = nfa_add(n, N_MATCH);
+    if (m < 0) return "out of memory";
+    n->st[m].rule = rule;
+    n->st[f.end].out = m;
+    if (n->start_count == n->start_cap) {
+        size_t cap = n->start_cap ? n->start_cap * 2 : 64;
+        int *starts = realloc(n->starts, cap * sizeof(int));
+        if (!starts) return "out of memory";
+        n->starts = starts;
+        unsigned char *anchored_grown = realloc(n->anchored, cap);
+        if (!anchored_grown) return "out of memory";
+        n->anchored = anchored_grown;
+        n->start_cap = cap;
+    }
+    n->starts[n->start_count] = f.start;
+    n->anchored[n->start_count++] = (unsigned char)anchored;
+    return NULL;
+}
+
+static const char *nfa_regex(struct nfa *n, const char *re, int rule) {
+    int anchored = re[0] == '^';
+    struct re_parser rp = { re + anchored, n, NULL };
+    struct frag f;
+    if (re_alt(&rp, &f) < 0) return rp.err;
+    if (*rp.p) return "unbalanced )";
+    return nfa_finish(n, f, rule, anchored);
+}
+
+// Literal bytes, optionally followed by any one byte (escape sequences)
+static const char *nfa_literal(struct nfa *n, const char *lit, int any_after, int rule) {
+    size_t len = strlen(lit);
+    if (!len) return "empty delimiter";
+    struct frag f = { -1, -1 };
+    for (size_t i = 0; i < len + (any_after ? 1 : 0); ++i) {
+        int s = nfa_add(n, N_SET);
+        if (s < 0) return "out of memory";
+        if (i < len) set_add(n->st[s].set, (unsigned char)lit[i]);
+        else set_range(n->st[s].set, 1, 255);
+        if (f.start < 0) f.start = s;
+        else n->st[f.end].out = s;
+        f.end = s;
+    }
+    return nfa_finish(n, f, rule, 0);
+}
+
+// Subset construction
+
+struct dfa_build {
+    struct nfa *nfa;
+    int **sets;                 // NFA states (SET/MATCH) per DFA state
+    size_t *set_len;
+    size_t count, cap;
+    int *slots;                 // hash of sets -> DFA state + 1
+    size_t slot_count;
+    int *mark;                  // closure visit marks
+    int gen;
+    int *stack, *tmp;
+};
+
+static uint64_t set_hash(const int *set, size_t n) {
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; ++i) h = (h ^ (uint64_t)set[i]) * 1099511628211ull;
+    return h;
+}
+
+static int cmp_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Epsilon closure of seeds (in place in b->tmp), returns its size
+static size_t closure(struct dfa_build *b, const int *seeds, size_t seed_count) {
+    size_t top = 0, n = 0;
+    b->gen++;
+    for (size_t i = 0; i < seed_count; ++i) b->stack[top++] = seeds[i];
+    while (top) {
+        int s = b->stack[--top];
+        if (s < 0 || b->mark[s] == b->gen) continue;
+        b->mark[s] = b->gen;
+        struct nfa_state *st = &b->nfa->st[s];
+        if (st->type == N_SPLIT) {
+            b->stack[top++] = st->out;
+            b->stack[top++] = st->out1;
+        } else if (st->type == N_EPS) {
+            b->stack[top++] = st->out;
+        } else {
+            b->tmp[n++] = s;
+        }
+    }
+    qsort(b->tmp, n, sizeof(int), cmp_int);
+    return n;
+}
+
+// DFA state for the set in b->tmp, adding it if new; -1 on failure
+static int dfa_state(struct dfa_build *b, size_t n) {
+    size_t mask = b->slot_count - 1;
+    size_t i = (size_t)set_hash(b->tmp, n) & mask;
+    for (; b->slots[i]; i = (i + 1) & mask) {
+        int id = b->slots[i] - 1;
+        if (b->set_len[id] == n && memcmp(b->sets[id], b->tmp, n * sizeof(int)) == 0)
+            return id;
+    }
+    if (b->count >= SYN_MAX_STATES) return -1;
+    if (b->count == b->cap) {
+        size_t cap = b->cap ? b->cap * 2 : 64;
+        int **sets = realloc(b->sets, cap * sizeof(int *));
+        if (!sets) return -1;
+        b->sets = sets;
+        size_t *set_len = realloc(b->set_len, cap * sizeof(size_t));
+        if (!set_len) return -1;
+        b->set_len = set_len;
+        b->cap = cap;
+    }
+    int *set = malloc((n ? n : 1) * sizeof(int));
+    if (!set) return -1;
+    memcpy(set, b->tmp, n * sizeof(int));
+    b->sets[b->count] = set;
+    b->set_len[b->count] = n;
+    b->slots[i] = (int)++b->count;
+
+    // Keep the table at most half full
+    if (b->count * 2 > b->slot_count) {
+        size_t count = b->slot_count * 2;
+        int *slots = calloc(count, sizeof(int));
+        if (!slots) return -1;
+        for (size_t k = 0; k < b->count; ++k) {
+            size_t j = (size_t)set_hash(b->sets[k], b->set_len[k]) & (count - 1);
+            while (slots[j]) j = (j + 1) & (count - 1);
+            slots[j] = (int)k + 1;
+        }
+        free(b->slots);
+        b->slots = slots;
+        b->slot_count = count;
+    }
+    return (int)b->count - 1;
+}
+
+static const char *dfa_compile(struct nfa *nfa, struct syn_dfa *d) {
+    const char *err = "out of memory";
+    struct dfa_build b = { .nfa = nfa, .slot_count = 256 };
+    memset(d, 0, sizeof(*d));
+
+    // Byte classes: bytes no rule can tell apart share a column
+    unsigned n_cls = 1;
+    for (size_t s = 0; s < nfa->count; ++s) {
+        if (nfa->st[s].type != N_SET) continue;
+        int remap[512];
+        unsigned n = 0;
+        memset(remap, -1, sizeof(remap));
+        for (unsigned c = 0; c < 256; ++c) {
+            int key = d->cls[c] * 2 + set_has(nfa->st[s].set, c);
+            if (remap[key] < 0) remap[key] = (int)n++;
+            d->cls[c] = (uint8_t)remap[key];
+        }
+        n_cls = n;
+    }
+    d->class_count = (uint16_t)n_cls;
+    unsigned char rep[256];
+    for (int c = 255; c >= 0; --c) rep[d->cls[c]] = (unsigned char)c;
+
+    b.slots = calloc(b.slot_count, sizeof(int));
+    b.mark = calloc(nfa->count ? nfa->count : 1, sizeof(int));
+    b.stack = malloc((3 * nfa->count + nfa->start_count + 1) * sizeof(int));
+    b.tmp = malloc((nfa->count + 1) * sizeof(int));
+    int *seeds = malloc((nfa->count + nfa->start_count + 1) * sizeof(int));
+    size_t next_cap = 0;
+    if (!b.slots || !b.mark || !b.stack || !b.tmp || !seeds) goto out;
+
+    // State 0 is the dead state, then the two start states
+    if (dfa_state(&b, 0) != 0) goto out;
+    size_t n = 0;
+    for (size_t i = 0; i < nfa->start_count; ++i) seeds[n++] = nfa->starts[i];
+    int bol = dfa_state(&b, closure(&b, seeds, n));
+    n = 0;
+    for (size_t i = 0; i < nfa->start_count; ++i)
+        if (!nfa->anchored[i]) seeds[n++] = nfa->starts[i];
+    int mid = dfa_state(&b, closure(&b, seeds, n));
+    if (bol < 0 || mid < 0) goto too_big;
+    d->start_bol = (uint16_t)bol;
+    d->start_mid = (uint16_t)mid;
+
+    for (size_t id = 0; id < b.count; ++id) {
+        if (b.count * n_cls > next_cap) {
+            size_t cap = next_cap ? next_cap : 64 * n_cls;
+            while (cap < b.count * n_cls) cap *= 2;
+            uint16_t *next = realloc(d->next, cap * sizeof(uint16_t));
+            if (!next) goto out;
+            d->next = next;
+            next_cap = cap;
+        }
+        for (unsigned k = 0; k < n_cls; ++k) {
+            n = 0;
+            for (size_t i = 0; i < b.set_len[id]; ++i) {
+                struct nfa_state *st = &nfa->st[b.sets[id][i]];
+                if (st->type == N_SET && set_has(st->set, rep[k])) seeds[n++] = st->out;
+            }
+            int t = dfa_state(&b, closure(&b, seeds, n));
+            if (t < 0) goto too_big;
+            d->next[id * n_cls + k] = (uint16_t)t;
+        }
+    }
+
+    // Lowest rule number wins among rules accepting in the same state
+    d->state_count = (uint16_t)b.count;
+    d->accept = malloc(b.count * sizeof(int16_t));
+    if (!d->accept) goto out;
+    for (size_t id = 0; id < b.count; ++id) {
+        int rule = -1;
+        for (size_t i = 0; i < b.set_len[id]; ++i) {
+            struct nfa_state *st = &nfa->st[b.sets[id][i]];
+            if (st->type == N_MATCH && (rule < 0 || st->rule < rule)) rule = st->rule;
+        }
+        d->accept[id] = (int16_t)rule;
+    }
+    err = NULL;
+    goto out;
+
+too_big:
+    err = "too many lexer states";
+out:
+    for (size_t i = 0; i < b.count; ++i) free(b.sets[i]);
+    free(b.sets);
+    free(b.set_len);
+    free(b.slots);
+    free(b.mark);
+    free(b.stack);
+    free(b.tmp);
+    free(seeds);
+    if (err) {
+        free(d->next);
+        free(d->accept);
+        d->next = NULL;
+        d->accept = NULL;
+    }
+    return err;
+}
+
+// Definition file parsing
+
+static const char *const class_names[HL_CLASS_COUNT] = {
+    [HL_NORMAL] = "normal", [HL_KEYWORD] = "keyword", [HL_TYPE] = "type",
+    [HL_STRING] = "string", [HL_COMMENT] = "comment", [HL_NUMBER] = "number",
+    [HL_PREPROC] = "preproc", [HL_TIME] = "time", [HL_ERROR] = "error",
+    [HL_WARN] = "warn", [HL_INFO] = "info", [HL_DEBUG] = "debug",
+};
+
+struct syn_match {
+    unsigned char cls;
+    char *regex;
+};
+
+struct syn_delim {
+    char *start, *end, *esc;    // end == NULL: line comment
+    unsigned char cls;
+};
+
+struct syn_def {
+    char **keywords, **types;
+    size_t keyword_count, type_count;
+    struct syn_delim *delims;
+    size_t delim_count;
+    struct syn_match *matches;
+    size_t match_count;
+};
+
+static int push(void **arr, size_t *count, size_t size, const void *item) {
+    void *grown = realloc(*arr, (*count + 1) * size);
+    if (!grown) return -1;
+    memcpy((char *)grown + *count * size, item, size);
+    *arr = grown;
+    (*count)++;
+    return 0;
+}
+
+static void def_free(struct syn_def *def) {
+    for (size_t i = 0; i < def->keyword_count; ++i) free(def->keywords[i]);
+    for (size_t i = 0; i < def->type_count; ++i) free(def->types[i]);
+    for (size_t i = 0; i < def->delim_count; ++i) {
+        free(def->delims[i].start);
+        free(def->delims[i].end);
+        free(def->delims[i].esc);
+    }
+    for (size_t i = 0; i < def->match_count; ++i) free(def->matches[i].regex);
+    free(def->keywords);
+    free(def->types);
+    free(def->delims);
+    free(def->matches);
+}
+
+static void fail(char *err, size_t errlen, int lineno, const char *fmt, ...) {
+    int n = lineno ? snprintf(err, errlen, "line %d: ", lineno) : 0;
+    va_list ap;
+    va_start(ap, fmt);
+    if (n >= 0 && (size_t)n < errlen) vsnprintf(err + n, errlen - n, fmt, ap);
+    va_end(ap);
+}
+
+// Split the next whitespace-separated word off *p, NUL-terminating it
+static char *word(char **p) {
+    char *s = *p;
+    while (*s == ' ' || *s == '\t') s++;
+    if (!*s) return NULL;
+    char *e = s;
+    while (*e && *e != ' ' && *e != '\t') e++;
+    if (*e) *e++ = '\0';
+    *p = e;
+    return s;
+}
+
+static int class_by_name(const char *name) {
+    for (int i = 0; i < HL_CLASS_COUNT; ++i)
+        if (strcmp(class_names[i], name) == 0) return i;
+    return -1;
+}
+
+static int parse_line(struct syntax *sx, struct syn_def *def, char *line,
+                      int lineno, char *err, size_t errlen) {
+    char *p = line;
+    char *dir = word(&p);
+    if (!dir || dir[0] == '#') return 0;
+
+    if (strcmp(dir, "name") == 0) {
+        char *name = word(&p);
+        if (!name) goto usage;
+        free(sx->name);
+        if (!(sx->name = strdup(name))) goto oom;
+    } else if (strcmp(dir, "ext") == 0) {
+        size_t count = 0;
+        while (sx->extensions && sx->extensions[count]) count++;
+        for (char *ext; (ext = word(&p));) {
+            char **grown = realloc(sx->extensions, (count + 2) * sizeof(char *));
+            if (!grown) goto oom;
+            sx->extensions = grown;
+            if (!(grown[count] = strdup(ext))) goto oom;
+            grown[++count] = NULL;
+        }
+    } else if (strcmp(dir, "keyword") == 0 || strcmp(dir, "type") == 0) {
+        int kw = dir[0] == 'k';
+        for (char *w; (w = word(&p));) {
+            char *copy = strdup(w);
+            if (!copy) goto oom;
+            if (kw ? push((void **)&def->keywords, &def->keyword_count, sizeof(char *), &copy)
+                   : push((void **)&def->types, &def->type_count, sizeof(char *), &copy)) {
+                free(copy);
+                goto oom;
+            }
+        }
+    } else if (strcmp(dir, "comment") == 0 || strcmp(dir, "string") == 0) {
+        int comment = dir[0] == 'c';
+        char *start = word(&p), *second = word(&p);
+        if (!start) goto usage;
+        // comment START [END]; string DELIM [ESCAPE]
+        struct syn_delim d = { NULL, NULL, NULL, comment ? HL_COMMENT : HL_STRING };
+        int ok = (d.start = strdup(start)) != NULL;
+        if (comment && second) ok = ok && (d.end = strdup(second)) != NULL;
+        if (!comment) ok = ok && (d.end = strdup(start)) != NULL;
+        if (!comment && second) ok = ok && (d.esc = strdup(second)) != NULL;
+        if (!ok || push((void **)&def->delims, &def->delim_count, sizeof(d), &d)) {
+            free(d.start);
+            free(d.end);
+            free(d.esc);
+            goto oom;
+        }
+    } else if (strcmp(dir, "match") == 0) {
+        char *cls = word(&p);
+        while (*p == ' ' || *p == '\t') p++;
+        size_t len = strlen(p);
+        while (len && (p[len - 1] == ' ' || p[len - 1] == '\t')) p[--len] = '\0';
+        if (!cls || !len) goto usage;
+        int c = class_by_name(cls);
+        if (c < 0) {
+            fail(err, errlen, lineno, "unknown class '%s'", cls);
+            return -1;
+        }
+        struct syn_match m = { (unsigned char)c, strdup(p) };
+        if (!m.regex || push((void **)&def->matches, &def->match_count, sizeof(m), &m)) {
+            free(m.regex);
+            goto oom;
+        }
+    } else {
+        fail(err, errlen, lineno, "unknown directive '%s'", dir);
+        return -1;
+    }
+    return 0;
+
+usage:
+    fail(err, errlen, lineno, "missing argument to '%s'", dir);
+    return -1;
+oom:
+    fail(err, errlen, lineno, "out of memory");
+    return -1;
+}
+
+static int add_rule(struct syntax *sx, unsigned char kind, unsigned char cls, unsigned short region) {
+    struct syn_rule r = { kind, cls, region };
+    if (sx->rule_count >= INT16_MAX) return -1;
+    if (push((void **)&sx->rules, &sx->rule_count, sizeof(r), &r)) return -1;
+    return (int)sx->rule_count - 1;
+}
+
+// Rules in priority order: keywords, types, delimiters, matches, words
+static const char *build_modes(struct syntax *sx, struct syn_def *def) {
+    struct nfa code = {0};
+    struct nfa *region_nfa = NULL;
+    const char *err = NULL;
+    int rule;
+
+    size_t regions = 0;
+    for (size_t i = 0; i < def->delim_count; ++i)
+        if (def->delims[i].end) regions++;
+    sx->regions = calloc(regions ? regions : 1, sizeof(*sx->regions));
+    sx->modes = calloc(regions + 1, sizeof(*sx->modes));
+    region_nfa = calloc(regions ? regions : 1, sizeof(*region_nfa));
+    if (!sx->regions || !sx->modes || !region_nfa) {
+        err = "out of memory";
+        goto out;
+    }
+
+    for (size_t i = 0; i < def->keyword_count && !err; ++i)
+        err = (rule = add_rule(sx, SYN_TOKEN, HL_KEYWORD, 0)) < 0 ? "out of memory"
+            : nfa_literal(&code, def->keywords[i], 0, rule);
+    for (size_t i = 0; i < def->type_count && !err; ++i)
+        err = (rule = add_rule(sx, SYN_TOKEN, HL_TYPE, 0)) < 0 ? "out of memory"
+            : nfa_literal(&code, def->types[i], 0, rule);
+
+    for (size_t i = 0; i < def->delim_count && !err; ++i) {
+        struct syn_delim *d = &def->delims[i];
+        if (!d->end) {
+            err = (rule = add_rule(sx, SYN_LINE, d->cls, 0)) < 0 ? "out of memory"
+                : nfa_literal(&code, d->start, 0, rule);
+            continue;
+        }
+        size_t r = sx->region_count++;
+        sx->regions[r].cls = d->cls;
+        sx->regions[r].single_line = d->cls == HL_STRING;
+        err = (rule = add_rule(sx, SYN_ENTER, d->cls, (unsigned short)r)) < 0 ? "out of memory"
+            : nfa_literal(&code, d->start, 0, rule);
+        if (!err)
+            err = (rule = add_rule(sx, SYN_EXIT, d->cls, 0)) < 0 ? "out of memory"
+                : nfa_literal(&region_nfa[r], d->end, 0, rule);
+        if (!err && d->esc)
+            err = (rule = add_rule(sx, SYN_STAY, d->cls, 0)) < 0 ? "out of memory"
+                : nfa_literal(&region_nfa[r], d->esc, 1, rule);
+    }
+
+    for (size_t i = 0; i < def->match_count && !err; ++i)
+        err = (rule = add_rule(sx, SYN_TOKEN, def->matches[i].cls, 0)) < 0 ? "out of memory"
+            : nfa_regex(&code, def->matches[i].regex, rule);
+
+    // Whole words last, so keywords and numbers never match inside them
+    if (!err)
+        err = (rule = add_rule(sx, SYN_TOKEN, HL_NORMAL, 0)) < 0 ? "out of memory"
+            : nfa_regex(&code, "[A-Za-z_][A-Za-z0-9_]*", rule);
+
+    if (!err) err = dfa_compile(&code, &sx->modes[0]);
+    for (size_t r = 0; r < sx->region_count && !err; ++r)
+        err = dfa_compile(&region_nfa[r], &sx->modes[r + 1]);
+
+out:
+    nfa_free(&code);
+    for (size_t r = 0; region_nfa && r < regions; ++r) nfa_free(&region_nfa[r]);
+    free(region_nfa);
+    return err;
+}
+
+// Lexer: longest match from each position, straight off the line
+
+static int syn_lex(const struct highlighter *h, const char *line, int state,
+                   unsigned char *attrs) {
+    const struct syntax *sx = h->ctx;
+    const unsigned char *s = (const unsigned char *)line;
+    size_t pos = 0;
+
+    while (s[pos]) {
+        const struct syn_dfa *d = &sx->modes[state];
+        unsigned st = pos ? d->start_mid : d->start_bol;
+        int rule = -1;
+        size_t end = pos + 1;
+        for (size_t i = pos; st && s[i]; ++i) {
+            st = d->next[st * d->class_count + d->cls[s[i]]];
+            int a = d->accept[st];
+            rule = a >= 0 ? a : rule;
+            end = a >= 0 ? i + 1 : end;
+        }
+
+        unsigned char cls = state ? sx->regions[state - 1].cls : HL_NORMAL;
+        if (rule >= 0) {
+            const struct syn_rule *r = &sx->rules[rule];
+            cls = r->cls;
+            if (r->kind == SYN_LINE) end = pos + strlen(line + pos);
+            else if (r->kind == SYN_ENTER) state = r->region + 1;
+            else if (r->kind == SYN_EXIT) state = 0;
+        }
+        if (attrs) memset(attrs + pos, cls, end - pos);
+        pos = end;
+    }
+
+    if (state && sx->regions[state - 1].single_line) state = 0;
+    return state;
+}
+
+// Public interface
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+struct syntax *syn_compile(const char *text, char *err, size_t errlen) {
+    uint64_t start = now_ns();
+    struct syntax *sx = calloc(1, sizeof(*sx));
+    struct syn_def def = {0};
+    char *copy = strdup(text);
+    if (!sx || !copy) {
+        fail(err, errlen, 0, "out of memory");
+        goto fail;
+    }
+
+    int lineno = 0;
+    for (char *line = copy, *next; line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        size_t len = strlen(line);
+        if (len && line[len - 1] == '\r') line[len - 1] = '\0';
+        if (parse_line(sx, &def, line, ++lineno, err, errlen) < 0) goto fail;
+    }
+    if (!sx->name && !(sx->name = strdup("custom"))) {
+        fail(err, errlen, 0, "out of memory");
+        goto fail;
+    }
+    if (!sx->extensions && !(sx->extensions = calloc(1, sizeof(char *)))) {
+        fail(err, errlen, 0, "out of memory");
+        goto fail;
+    }
+
+    const char *why = build_modes(sx, &def);
+    if (why) {
+        fail(err, errlen, 0, "%s", why);
+        goto fail;
+    }
+
+    sx->hl.name = sx->name;
+    sx->hl.extensions = (const char *const *)sx->extensions;
+    sx->hl.lex = syn_lex;
+    sx->hl.ctx = sx;
+    free(copy);
+    def_free(&def);
+    sx->compile_ns = now_ns() - start;
+    return sx;
+
+fail:
+    free(copy);
+    def_free(&def);
+    syn_free(sx);
+    return NULL;
+}
+
+struct syntax *syn_compile_file(const char *path, char *err, size_t errlen) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fail(err, errlen, 0, "%s: cannot open", path);
+        return NULL;
+    }
+    char *text = NULL;
+    size_t len = 0, cap = 0;
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) {
+        if (len + n + 1 > cap) {
+            cap = (len + n + 1) * 2;
+            char *grown = realloc(text, cap);
+            if (!grown) {
+                free(text);
+                fclose(f);
+                fail(err, errlen, 0, "%s: out of memory", path);
+                return NULL;
+            }
+            text = grown;
+        }
+        memcpy(text + len, buf, n);
+        len += n;
+    }
+    fclose(f);
+
+    if (text) text[len] = '\0';
+    struct syntax *sx = syn_compile(text ? text : "", err, errlen);
+    free(text);
+    if (!sx) {
+        char why[256];
+        snprintf(why, sizeof(why), "%s", err);
+        fail(err, errlen, 0, "%s: %s", path, why);
+    }
+    return sx;
+}
+
+void syn_free(struct syntax *sx) {
+    if (!sx) return;
+    for (size_t i = 0; sx->extensions && sx->extensions[i]; ++i) free(sx->extensions[i]);
+    free(sx->extensions);
+    free(sx->name);
+    free(sx->rules);
+    for (size_t m = 0; sx->modes && m <= sx->region_count; ++m) {
+        free(sx->modes[m].next);
+        free(sx->modes[m].accept);
+    }
+    free(sx->modes);
+    free(sx->regions);
+    free(sx);
+}
+
+size_t syn_state_count(const struct syntax *sx) {
+    size_t n = 0;
+    for (size_t m = 0; m <= sx->region_count; ++m) n += sx->modes[m].state_count;
+    return n;
+}
@@ -0,0 +1,70 @@
+/* syntax.h - user syntax definitions compiled to transition tables
+   A definition file lists keywords, comment and string delimiters and
+   token regexes; at start-up it is compiled into one DFA per lexer mode
+   (code, and the inside of each comment/string) with byte classes and a
+   flat next-state table, then exposed as an ordinary highlighter.
+
+   File format, one directive per line, '#' starts a comment line:
+       name    NAME
+       ext     .EXT ...
+       keyword WORD ...
+       type    WORD ...
+       comment START           line comment
+       comment START END       block comment, may span lines
+       string  DELIM [ESCAPE]  string, ends with the line
+       match   CLASS REGEX     token regex, rest of line, ^ anchors
+   Regexes support literals, ., [...] classes, (), |, *, + and ?, and
+   the escapes \d \w \s \t.  See syntax/ for examples.
+*/
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <stddef.h>   /* for size_t */
+#include <stdint.h>
+
+#include "highlight.h"
+
+/*--------------------------------------------------------------------
+  Compiled form
+ --------------------------------------------------------------------*/
+struct syn_dfa {
+    uint8_t cls[256];           /* byte -> byte class                  */
+    uint16_t class_count;
+    uint16_t state_count;       /* state 0 is the dead state           */
+    uint16_t start_bol;         /* start state at column 0             */
+    uint16_t start_mid;         /* start state anywhere else           */
+    uint16_t *next;             /* [state * class_count + class]       */
+    int16_t *accept;            /* rule per state, -1 if not accepting */
+};
+
+struct syn_rule {
+    unsigned char kind;         /* SYN_TOKEN, SYN_LINE, ...            */
+    unsigned char cls;          /* hl_class of the matched bytes       */
+    unsigned short region;      /* region entered by SYN_ENTER         */
+};
+
+enum { SYN_TOKEN, SYN_LINE, SYN_ENTER, SYN_EXIT, SYN_STAY };
+
+struct syn_region {
+    unsigned char cls;
+    unsigned char single_line;  /* strings end with the line           */
+};
+
+struct syntax {
+    char *name;
+    char **extensions;          /* NULL-terminated                     */
+    struct syn_rule *rules;
+    size_t rule_count;
+    struct syn_region *regions;
+    size_t region_count;
+    struct syn_dfa *modes;      /* [0] code, [r + 1] inside region r   */
+    uint64_t compile_ns;        /* time spent in syn_compile()         */
+    struct highlighter hl;
+};
+
+struct syntax *syn_compile(const char *text, char *err, size_t errlen);
+struct syntax *syn_compile_file(const char *path, char *err, size_t errlen);
+void syn_free(struct syntax *sx);
+size_t syn_state_count(const struct syntax *sx);
+
+#endif /* SYNTAX_H */
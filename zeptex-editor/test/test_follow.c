@@ -0,0 +1,88 @@
+/* test_follow.c - follow mode across truncation and rotation
+   Follows a file that ends in a partial line, then truncates it in
+   place (copytruncate) or replaces it (rename and recreate) and writes
+   new content.  The partial line must stay in the buffer as a finished
+   line, and the new file's first line must start a line of its own.
+
+   make test    (or: gcc -O2 -pthread -I. -o test_follow test/test_follow.c \
+       buffer.c diff.c editor.c edits.c follow.c highlight.c input.c pager.c \
+       reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz)
+*/
+#include "editor.h"
+#include "follow.h"
+
+#include <fcntl.h>
+
+static const char *path = "/tmp/test_follow.log";
+static const char *moved = "/tmp/test_follow.log.1";
+static int checks, failures;
+
+#define CHECK(cond) do {                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+        }                                                               \
+    } while (0)
+
+// Write text to path: appended, or to a new or emptied file
+static void put(const char *text, int flags) {
+    int fd = open(path, O_WRONLY | O_CREAT | flags, 0600);
+    if (fd < 0) return;
+    if (write(fd, text, strlen(text)) != (ssize_t)strlen(text)) perror(path);
+    close(fd);
+}
+
+// The buffer is exactly the given lines
+static int buffer_is(const char *const *want, size_t n) {
+    if (line_count != n) return 0;
+    for (size_t i = 0; i < n; ++i)
+        if (strcmp(lines[i], want[i]) != 0) return 0;
+    return 1;
+}
+
+static void start(const char *text) {
+    while (line_count) delete_line(line_count);
+    put(text, O_TRUNC);
+    CHECK(follow_start(path) == 0);
+}
+
+static void test_partial_then_truncate(void) {
+    start("one\ntwo\npart");
+    static const char *const before[] = { "one", "two", "part" };
+    CHECK(buffer_is(before, 3));
+
+    put("", O_TRUNC);
+    follow_update();
+    put("new\nmore", O_APPEND);
+    CHECK(follow_update() == 1);
+    static const char *const after[] = { "one", "two", "part", "new", "more" };
+    CHECK(buffer_is(after, 5));
+
+    put(" still\n", O_APPEND);      // the new partial line goes on as usual
+    CHECK(follow_update() == 1);
+    static const char *const grown[] = { "one", "two", "part", "new", "more still" };
+    CHECK(buffer_is(grown, 5));
+    follow_stop();
+}
+
+static void test_partial_then_rotate(void) {
+    start("one\npart");
+    CHECK(rename(path, moved) == 0);
+    put("new\n", O_TRUNC);
+    CHECK(follow_update() == 1);
+    static const char *const after[] = { "one", "part", "new" };
+    CHECK(buffer_is(after, 3));
+    follow_stop();
+    remove(moved);
+}
+
+int main(void) {
+    test_partial_then_truncate();
+    test_partial_then_rotate();
+    while (line_count) delete_line(line_count);
+    remove(path);
+
+    printf("test_follow: %d checks, %d failed\n", checks, failures);
+    return failures != 0;
+}
@@ -0,0 +1,212 @@
+/* test_patch.c - patch FILE and the apply_edits batches it makes
+   Applies unified diffs to a small buffer: a hunk found where its header
+   says, one found elsewhere (moved), one found only by ignoring a line
+   of context (fuzz) and one that is not there at all (rejected).  Then
+   checks that apply_edits refuses a malformed batch and leaves the
+   buffer alone, and that the highlight cache and the trigram index it
+   updates in place agree with ones built from scratch.
+
+   make test    (or: gcc -O2 -pthread -I. -o test_patch test/test_patch.c \
+       buffer.c diff.c editor.c edits.c follow.c highlight.c input.c pager.c \
+       reload.c search.c stats.c stream.c stream_gz.c trace.c trigram.c watch.c -lz)
+*/
+#include "editor.h"
+#include "diff.h"
+#include "highlight.h"
+#include "trigram.h"
+
+#include <errno.h>
+
+extern char status_msg[256];
+
+static const char *patch_path = "/tmp/test_patch.diff";
+static int checks, failures;
+
+#define CHECK(cond) do {                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+        }                                                               \
+    } while (0)
+
+// The buffer holds "line 1" .. "line n"
+static void fill(size_t n) {
+    while (line_count) delete_line(line_count);
+    char text[32];
+    for (size_t i = 1; i <= n; ++i) {
+        snprintf(text, sizeof(text), "line %zu", i);
+        insert_line(i, text);
+    }
+}
+
+// The buffer is exactly the given lines
+static int buffer_is(const char *const *want, size_t n) {
+    if (line_count != n) return 0;
+    for (size_t i = 0; i < n; ++i)
+        if (strcmp(lines[i], want[i]) != 0) return 0;
+    return 1;
+}
+
+static int patch(const char *text) {
+    FILE *f = fopen(patch_path, "w");
+    if (!f) return -2;
+    fputs(text, f);
+    fclose(f);
+    status_msg[0] = '\0';
+    return patch_apply(patch_path);
+}
+
+static const char hunk[] =
+    "--- a/file\n"
+    "+++ b/file\n"
+    "@@ -4,5 +4,5 @@\n"
+    " line 4\n"
+    " line 5\n"
+    "-line 6\n"
+    "+line six\n"
+    " line 7\n"
+    " line 8\n";
+
+static void test_clean(void) {
+    fill(10);
+    CHECK(patch(hunk) == 0);
+    static const char *const want[] = { "line 1", "line 2", "line 3", "line 4", "line 5",
+                                        "line six", "line 7", "line 8", "line 9", "line 10" };
+    CHECK(buffer_is(want, 10));
+    CHECK(strstr(status_msg, "1 of 1 hunks applied (0 moved, 0 with fuzz)") != NULL);
+}
+
+static void test_moved(void) {
+    fill(10);
+    insert_line(1, "new 1");
+    insert_line(1, "new 2");
+    CHECK(patch(hunk) == 0);
+    CHECK(line_count == 12 && strcmp(lines[7], "line six") == 0);
+    CHECK(strstr(status_msg, "(1 moved, 0 with fuzz)") != NULL);
+}
+
+static void test_fuzz(void) {
+    fill(10);
+    free(lines[3]);
+    lines[3] = strdup("line four");     // the first context line no longer matches
+    CHECK(patch(hunk) == 0);
+    CHECK(strcmp(lines[3], "line four") == 0 && strcmp(lines[5], "line six") == 0);
+    CHECK(strstr(status_msg, "(0 moved, 1 with fuzz)") != NULL);
+}
+
+static void test_rejected(void) {
+    fill(10);
+    CHECK(patch("--- a/file\n"
+                "+++ b/file\n"
+                "@@ -4,3 +4,3 @@\n"
+                " no such line\n"
+                "-nor this one\n"
+                "+replacement\n"
+                " nor that\n") == -1);
+    CHECK(line_count == 10 && strcmp(lines[5], "line 6") == 0);
+    CHECK(strstr(status_msg, "0 of 1 hunks applied") != NULL);
+    CHECK(strstr(status_msg, "failed: #1") != NULL);
+}
+
+// A batch edits_check() refuses fails before anything changes; the
+// cases it refuses are tested with zx_apply in test_zeptex.c
+static void test_bad_batches(void) {
+    static const zx_edit twice[] = {
+        { ZX_INSERT, 0, "x", 1 }, { ZX_DELETE, 3, NULL, 0 }, { ZX_DELETE, 3, NULL, 0 },
+    };
+
+    fill(10);
+    errno = 0;
+    CHECK(apply_edits(twice, 3) == -1 && errno == EINVAL);
+    CHECK(line_count == 10 && strcmp(lines[0], "line 1") == 0 && strcmp(lines[2], "line 3") == 0);
+
+    static const zx_edit good[] = {
+        { ZX_INSERT, 0, "first", 5 }, { ZX_DELETE, 3, NULL, 0 },
+        { ZX_INSERT, 3, "x", 1 }, { ZX_INSERT, 10, "last", 4 },
+    };
+    CHECK(apply_edits(good, 4) == 0);
+    static const char *const want[] = { "first", "line 1", "line 2", "line 3", "x", "line 5",
+                                        "line 6", "line 7", "line 8", "line 9", "line 10",
+                                        "last" };
+    CHECK(buffer_is(want, 12));
+}
+
+// The states kept across a batch give the same colours as lexing anew
+static void test_highlight(void) {
+    fill(0);
+    static const char *const src[] = {
+        "int a;", "/* one", "still comment", "*/", "int b;", "int c;", "char d;", "int e;",
+    };
+    for (size_t i = 0; i < 8; ++i) insert_line(i + 1, src[i]);
+    hl_set(&hl_c);
+    for (size_t i = 0; i < line_count; ++i) hl_line_attrs(i);      // all cached
+
+    static const zx_edit edits[] = {
+        { ZX_DELETE, 3, NULL, 0 },              // the comment now runs on
+        { ZX_INSERT, 5, "/* two", 6 },
+        { ZX_DELETE, 6, NULL, 0 },
+    };
+    CHECK(apply_edits(edits, 3) == 0);
+    unsigned char got[8][16];
+    for (size_t i = 0; i < line_count; ++i)
+        memcpy(got[i], hl_line_attrs(i), strlen(lines[i]));
+    hl_set(&hl_c);
+    for (size_t i = 0; i < line_count; ++i)
+        CHECK(memcmp(got[i], hl_line_attrs(i), strlen(lines[i])) == 0);
+    hl_set(NULL);
+}
+
+// The index's candidates for lit are valid lines and include every match
+static int index_agrees(const char *lit) {
+    size_t *cand = NULL;
+    long found = tri_candidates(lit, strlen(lit), &cand);
+    int ok = found >= 0;
+    long k = 0;
+    for (long i = 0; ok && i < found; ++i) ok = cand[i] < line_count;
+    for (size_t i = 0; ok && i < line_count; ++i) {
+        if (!strstr(lines[i], lit)) continue;
+        while (k < found && cand[k] < i) k++;
+        ok = k < found && cand[k] == i;
+    }
+    free(cand);
+    return ok;
+}
+
+// After a batch, the index narrows searches to the lines a scan finds
+static void test_trigram(void) {
+    fill(200);
+    CHECK(tri_enable() == 0);
+    while (!tri_ready()) usleep(1000);
+
+    zx_edit edits[40];
+    size_t n = 0;
+    for (size_t at = 10; at < 200; at += 20) {
+        edits[n++] = (zx_edit){ ZX_DELETE, at, NULL, 0 };
+        edits[n++] = (zx_edit){ ZX_INSERT, at + 1, "needle here", 11 };
+    }
+    CHECK(apply_edits(edits, n) == 0);
+    CHECK(index_agrees("needle"));
+    CHECK(index_agrees("line 1"));
+    CHECK(index_agrees("line 19"));
+
+    size_t *cand = NULL;
+    CHECK(tri_candidates("needle", 6, &cand) == (long)(n / 2));
+    free(cand);
+    tri_disable();
+}
+
+int main(void) {
+    test_clean();
+    test_moved();
+    test_fuzz();
+    test_rejected();
+    test_bad_batches();
+    test_highlight();
+    test_trigram();
+    fill(0);
+    remove(patch_path);
+
+    printf("test_patch: %d checks, %d failed\n", checks, failures);
+    return failures != 0;
+}
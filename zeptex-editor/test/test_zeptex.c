@@ -0,0 +1,176 @@
+/* test_zeptex.c - zx_apply against one zx_insert/zx_delete per edit
+   Checks that zx_apply refuses unsorted, out-of-range and double-delete
+   batches with EINVAL and leaves the buffer alone, and that a valid
+   batch, written by hand or at random, gives the same lines as its
+   edits applied one call at a time.
+
+   make test    (or: gcc -O2 -pthread -I. -o test_zeptex test/test_zeptex.c \
+       zeptex.c edits.c stream.c stream_gz.c -lz)
+*/
+#include "zeptex.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 200          // random batches
+
+static int checks, failures;
+
+#define CHECK(cond) do {                                                \
+        checks++;                                                       \
+        if (!(cond)) {                                                  \
+            failures++;                                                 \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);  \
+        }                                                               \
+    } while (0)
+
+// A buffer of "line 0" .. "line n-1"
+static zx_buffer *filled(size_t n) {
+    zx_buffer *b = zx_buffer_new();
+    char text[32];
+    for (size_t i = 0; b && i < n; ++i) {
+        int len = snprintf(text, sizeof(text), "line %zu", i);
+        if (zx_insert(b, i, text, (size_t)len) < 0) {
+            zx_buffer_free(b);
+            return NULL;
+        }
+    }
+    return b;
+}
+
+static int same_lines(const zx_buffer *a, const zx_buffer *b) {
+    if (zx_line_count(a) != zx_line_count(b)) return 0;
+    zx_iter ia, ib;
+    zx_iter_init(&ia, a, 0);
+    zx_iter_init(&ib, b, 0);
+    const char *x, *y;
+    size_t xn, yn;
+    while ((x = zx_iter_next(&ia, &xn)) && (y = zx_iter_next(&ib, &yn)))
+        if (xn != yn || memcmp(x, y, xn) != 0) return 0;
+    return 1;
+}
+
+// The batch one call at a time.  shift is the lines added so far before
+// original line index; a delete waits for the inserts that go before
+// its line, so that it removes the line and not one of them.
+static int apply_one_by_one(zx_buffer *b, const zx_edit *edits, size_t n) {
+    long shift = 0;
+    int pending = 0;
+    size_t at = 0;
+    for (size_t k = 0; k <= n; ++k) {
+        if (pending && (k == n || edits[k].index > at)) {
+            if (zx_delete(b, at + (size_t)shift) < 0) return -1;
+            shift--;
+            pending = 0;
+        }
+        if (k == n) break;
+        const zx_edit *e = &edits[k];
+        if (e->op == ZX_DELETE) {
+            pending = 1;
+            at = e->index;
+        } else {
+            if (zx_insert(b, e->index + (size_t)shift, e->text, e->len) < 0) return -1;
+            shift++;
+        }
+    }
+    return 0;
+}
+
+static int batch_matches(size_t lines, const zx_edit *edits, size_t n) {
+    zx_buffer *a = filled(lines), *b = filled(lines);
+    int ok = a && b && zx_apply(a, edits, n) == 0 && apply_one_by_one(b, edits, n) == 0 &&
+             same_lines(a, b);
+    zx_buffer_free(a);
+    zx_buffer_free(b);
+    return ok;
+}
+
+// Malformed batches fail with EINVAL before anything changes
+static void test_rejected(void) {
+    static const zx_edit unsorted[] = {
+        { ZX_DELETE, 5, NULL, 0 }, { ZX_INSERT, 2, "x", 1 },
+    };
+    static const zx_edit past_end[] = { { ZX_INSERT, 11, "x", 1 } };
+    static const zx_edit delete_end[] = { { ZX_DELETE, 10, NULL, 0 } };
+    static const zx_edit twice[] = { { ZX_DELETE, 3, NULL, 0 }, { ZX_DELETE, 3, NULL, 0 } };
+    static const zx_edit twice_apart[] = {
+        { ZX_DELETE, 3, NULL, 0 }, { ZX_INSERT, 3, "x", 1 }, { ZX_DELETE, 3, NULL, 0 },
+    };
+    static const zx_edit late[] = {     // valid edits first, the bad one last
+        { ZX_INSERT, 0, "x", 1 }, { ZX_DELETE, 4, NULL, 0 }, { ZX_INSERT, 12, "y", 1 },
+    };
+    static const zx_edit unknown[] = { { 7, 0, NULL, 0 } };
+    const struct { const zx_edit *e; size_t n; } bad[] = {
+        { unsorted, 2 }, { past_end, 1 }, { delete_end, 1 }, { twice, 2 },
+        { twice_apart, 3 }, { late, 3 }, { unknown, 1 },
+    };
+
+    zx_buffer *b = filled(10), *orig = filled(10);
+    CHECK(b && orig);
+    if (!b || !orig) return;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        errno = 0;
+        CHECK(zx_apply(b, bad[i].e, bad[i].n) == -1 && errno == EINVAL);
+        CHECK(same_lines(b, orig));
+    }
+    zx_buffer_free(b);
+    zx_buffer_free(orig);
+}
+
+static void test_by_hand(void) {
+    static const zx_edit edits[] = {
+        { ZX_INSERT, 0, "first", 5 },
+        { ZX_DELETE, 3, NULL, 0 }, { ZX_INSERT, 3, "three", 5 },      // replaces line 3
+        { ZX_INSERT, 5, "a", 1 }, { ZX_INSERT, 5, "b", 1 }, { ZX_DELETE, 5, NULL, 0 },
+        { ZX_DELETE, 6, NULL, 0 },
+        { ZX_DELETE, 9, NULL, 0 }, { ZX_INSERT, 10, "last", 4 },
+    };
+    CHECK(batch_matches(10, edits, sizeof(edits) / sizeof(edits[0])));
+
+    zx_buffer *b = filled(10);
+    CHECK(b && zx_apply(b, edits, sizeof(edits) / sizeof(edits[0])) == 0);
+    static const char *const want[] = { "first", "line 0", "line 1", "line 2", "three",
+                                        "line 4", "a", "b", "line 7", "line 8", "last" };
+    size_t n = sizeof(want) / sizeof(want[0]), len;
+    CHECK(b && zx_line_count(b) == n);
+    for (size_t i = 0; b && i < n && i < zx_line_count(b); ++i)
+        CHECK(strcmp(zx_line(b, i, &len), want[i]) == 0 && len == strlen(want[i]));
+    zx_buffer_free(b);
+
+    CHECK(batch_matches(0, NULL, 0));
+    CHECK(batch_matches(10, NULL, 0));
+}
+
+static void test_random(void) {
+    srand(1);
+    zx_edit edits[64];
+    int ok = 1;
+    for (int round = 0; round < ROUNDS && ok; ++round) {
+        size_t lines = (size_t)(rand() % 40), n = 0, at = 0;
+        int deleted = 0;            // line at is deleted already
+        while (n < sizeof(edits) / sizeof(edits[0]) && rand() % 8) {
+            at += (size_t)(rand() % 3 == 0 ? rand() % 4 : 0);
+            if (at > lines) break;
+            if (at != (n ? edits[n - 1].index : 0)) deleted = 0;
+            if (at < lines && !deleted && rand() % 2) {
+                edits[n++] = (zx_edit){ ZX_DELETE, at, NULL, 0 };
+                deleted = 1;
+            } else {
+                edits[n++] = (zx_edit){ ZX_INSERT, at, "new", 3 };
+            }
+        }
+        ok = batch_matches(lines, edits, n);
+    }
+    CHECK(ok);
+}
+
+int main(void) {
+    test_rejected();
+    test_by_hand();
+    test_random();
+
+    printf("test_zeptex: %d checks, %d failed\n", checks, failures);
+    return failures != 0;
+}
@@ -0,0 +1,155 @@
+#include "editor.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#ifdef ZEPTEX_TRACE
+
+#define TRACE_EVENTS 65536          // per thread, a power of two
+
+struct event {
+    const char *name;
+    uint64_t start, end;            // TRACE_BEGIN() ticks
+};
+
+struct ring {
+    struct event ev[TRACE_EVENTS];
+    uint64_t head;                  // spans written; stored by the owner only
+    int owned;                      // a live thread writes to it
+    int tid;
+    struct ring *next;
+};
+
+static struct ring *rings;          // rings are never freed, only reused
+static __thread struct ring *mine;
+static pthread_key_t ring_key;      // hands the ring back at thread exit
+static int tids;
+static uint64_t ticks0, ns0;        // one point in both clocks
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t trace_clock(void) {
+    return now_ns();
+}
+
+// Rings
+
+static void ring_release(void *r) {
+    __atomic_store_n(&((struct ring *)r)->owned, 0, __ATOMIC_RELEASE);
+}
+
+// Before main, so that no span can start before ticks0
+__attribute__((constructor)) static void setup(void) {
+    pthread_key_create(&ring_key, ring_release);
+    ticks0 = TRACE_BEGIN();
+    ns0 = now_ns();
+}
+
+// A ring for this thread: one left by a thread that ended, or a new one
+static struct ring *ring_take(void) {
+    struct ring *r;
+    for (r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        int free_ring = 0;
+        if (__atomic_compare_exchange_n(&r->owned, &free_ring, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (!r) {
+        if (!(r = calloc(1, sizeof(*r)))) return NULL;
+        r->owned = 1;
+        r->tid = __atomic_add_fetch(&tids, 1, __ATOMIC_RELAXED);
+        r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&rings, &r->next, r, 1,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(ring_key, r);
+    return mine = r;
+}
+
+void trace_span(const char *name, uint64_t start) {
+    struct ring *r = mine;
+    if (!r && !(r = ring_take())) return;
+    uint64_t h = r->head;
+    struct event *e = &r->ev[h & (TRACE_EVENTS - 1)];
+    e->name = name;
+    e->start = start;
+    e->end = TRACE_BEGIN();
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+// Export
+
+// Copy out the spans still in a ring; its thread may go on writing
+static size_t ring_copy(struct ring *r, struct event *out) {
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    for (uint64_t i = first; i < head; ++i) out[i - first] = r->ev[i & (TRACE_EVENTS - 1)];
+
+    // Drop what was overwritten meanwhile, and the slot being written now
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t now = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    uint64_t valid = now >= TRACE_EVENTS ? now - TRACE_EVENTS + 1 : 0;
+    if (valid <= first) return (size_t)(head - first);
+    if (valid >= head) return 0;
+    memmove(out, out + (valid - first), (size_t)(head - valid) * sizeof(struct event));
+    return (size_t)(head - valid);
+}
+
+static int write_trace(FILE *f, size_t *spans) {
+    struct event *ev = malloc(TRACE_EVENTS * sizeof(struct event));
+    if (!ev) return -1;
+
+    uint64_t ticks = TRACE_BEGIN(), ns = now_ns();
+    double per_us = ns > ns0 ? (double)(ticks - ticks0) * 1e3 / (double)(ns - ns0) : 1e3;
+    int pid = (int)getpid();
+    const char *sep = "";
+
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (struct ring *r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        size_t n = ring_copy(r, ev);
+        for (size_t i = 0; i < n; ++i) {
+            // Another CPU's counter may be a little behind
+            uint64_t since = ev[i].start > ticks0 ? ev[i].start - ticks0 : 0;
+            fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                       "\"ts\":%.3f,\"dur\":%.3f}",
+                    sep, ev[i].name, pid, r->tid, (double)since / per_us,
+                    (double)(ev[i].end - ev[i].start) / per_us);
+            sep = ",\n";
+        }
+        *spans += n;
+    }
+    fprintf(f, "\n]}\n");
+    free(ev);
+    return 0;
+}
+
+void trace_command(const char *arg) {
+    char path[256];
+    if (sscanf(arg, "%255s", path) != 1) {
+        set_status("Use: trace FILE");
+        return;
+    }
+
+    size_t spans = 0;
+    FILE *f = fopen(path, "w");
+    int failed = !f || write_trace(f, &spans) < 0;
+    if (f && fclose(f) != 0) failed = 1;
+    if (failed) set_status("trace %s: %s", path, strerror(errno));
+    else set_status("%zu spans written to %s", spans, path);
+}
+
+#else
+
+void trace_command(const char *arg) {
+    (void)arg;
+    set_status("Tracing is not built in: make clean && make TRACE=1");
+}
+
+#endif
@@ -0,0 +1,40 @@
+/* trace.h - span events for profiling a session
+   Built with ZEPTEX_TRACE (make TRACE=1), TRACE_BEGIN and TRACE_END
+   record a named span into a ring buffer owned by the calling thread,
+   stamped with the CPU's time stamp counter.  The ring keeps the last
+   TRACE_EVENTS spans; writing one takes no lock and never waits.
+   "trace FILE" writes the spans of every thread as Chrome trace JSON,
+   for chrome://tracing or ui.perfetto.dev.  Without ZEPTEX_TRACE the
+   macros compile to nothing.
+
+       uint64_t t = TRACE_BEGIN();
+       ...
+       TRACE_END(t, "render");
+
+   Names are string literals: they are kept as pointers and written to
+   the JSON unescaped.
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#ifdef ZEPTEX_TRACE
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_BEGIN()           __rdtsc()
+#else
+#define TRACE_BEGIN()           trace_clock()
+#endif
+#define TRACE_END(start, name)  trace_span(name, start)
+
+uint64_t trace_clock(void);                         /* ns, where there is no TSC */
+void trace_span(const char *name, uint64_t start);  /* ends now */
+#else
+#define TRACE_BEGIN()           0
+#define TRACE_END(start, name)  ((void)(start))
+#endif
+
+void trace_command(const char *arg);    /* "trace FILE" */
+
+#endif /* TRACE_H */
@@ -0,0 +1,417 @@
+#include "editor.h"
+#include "trace.h"
+#include "trigram.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRI_BATCH 256       // lines indexed per lock acquisition
+
+// Lines are indexed under a stable id so that inserts and deletes only
+// touch the lines they add or remove; posting lists hold ids in
+// ascending order, which keeps intersections a linear merge.
+struct posting {
+    uint32_t key;           // three bytes of text, 0 = empty slot
+    uint32_t n, cap;
+    uint32_t *ids;
+};
+
+static pthread_mutex_t tri_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct tri_state {
+    int enabled;
+    int ready;              // every live id is in the postings
+    int stop;
+    int failed;             // ran out of memory, postings incomplete
+    int running;            // builder started and not joined yet
+    pthread_t builder;
+    size_t built;           // ids below this are in the postings
+
+    char **id_text;         // line text per id, NULL once deleted
+    size_t id_count, id_cap, dead;
+
+    uint32_t *id_of_line;   // main-thread only, parallel to lines[]
+    size_t *line_of_id;
+    size_t line_cap;
+
+    struct posting *slots;  // open-addressing table keyed by trigram
+    size_t slot_count, slot_used;
+} tri;
+
+// Posting table
+
+static size_t tri_hash(uint32_t key) {
+    return (size_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static struct posting *tri_find(uint32_t key) {
+    if (!tri.slot_count) return NULL;
+    size_t mask = tri.slot_count - 1;
+    for (size_t i = tri_hash(key) & mask;; i = (i + 1) & mask) {
+        if (tri.slots[i].key == key) return &tri.slots[i];
+        if (tri.slots[i].key == 0) return NULL;
+    }
+}
+
+static int tri_grow(void) {
+    size_t count = tri.slot_count ? tri.slot_count * 2 : 4096;
+    struct posting *slots = calloc(count, sizeof(*slots));
+    if (!slots) return -1;
+    for (size_t i = 0; i < tri.slot_count; ++i) {
+        if (!tri.slots[i].key) continue;
+        size_t j = tri_hash(tri.slots[i].key) & (count - 1);
+        while (slots[j].key) j = (j + 1) & (count - 1);
+        slots[j] = tri.slots[i];
+    }
+    free(tri.slots);
+    tri.slots = slots;
+    tri.slot_count = count;
+    return 0;
+}
+
+static struct posting *tri_get(uint32_t key) {
+    if ((tri.slot_used + 1) * 10 > tri.slot_count * 7 && tri_grow() < 0)
+        return NULL;
+    size_t mask = tri.slot_count - 1;
+    size_t i = tri_hash(key) & mask;
+    while (tri.slots[i].key && tri.slots[i].key != key) i = (i + 1) & mask;
+    if (!tri.slots[i].key) {
+        tri.slots[i].key = key;
+        tri.slot_used++;
+    }
+    return &tri.slots[i];
+}
+
+// Add every trigram of text to the postings of id (lock held)
+static void tri_index_line(uint32_t id, const char *text) {
+    const unsigned char *s = (const unsigned char *)text;
+    if (!s[0] || !s[1]) return;
+    for (; s[2]; ++s) {
+        uint32_t key = (uint32_t)s[0] << 16 | (uint32_t)s[1] << 8 | s[2];
+        struct posting *p = tri_get(key);
+        if (!p) {
+            tri.failed = 1;
+            return;
+        }
+        if (p->n && p->ids[p->n - 1] == id) continue;   // repeat in line
+        if (p->n == p->cap) {
+            uint32_t cap = p->cap ? p->cap * 2 : 4;
+            uint32_t *ids = realloc(p->ids, cap * sizeof(uint32_t));
+            if (!ids) {
+                tri.failed = 1;
+                return;
+            }
+            p->ids = ids;
+            p->cap = cap;
+        }
+        p->ids[p->n++] = id;
+    }
+}
+
+// Drop deleted ids from every posting list (lock held)
+static void tri_compact(void) {
+    for (size_t i = 0; i < tri.slot_count; ++i) {
+        struct posting *p = &tri.slots[i];
+        uint32_t k = 0;
+        for (uint32_t j = 0; j < p->n; ++j)
+            if (tri.id_text[p->ids[j]]) p->ids[k++] = p->ids[j];
+        p->n = k;
+    }
+    tri.dead = 0;
+}
+
+// Background builder: walks ids in ascending order, including ids
+// handed out by inserts while it runs, then flips the index to ready
+static void *tri_build(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&tri_lock);
+        if (tri.stop) {
+            pthread_mutex_unlock(&tri_lock);
+            break;
+        }
+        uint64_t t = TRACE_BEGIN();
+        size_t end = tri.built + TRI_BATCH;
+        for (; tri.built < end && tri.built < tri.id_count; ++tri.built)
+            if (tri.id_text[tri.built]) tri_index_line((uint32_t)tri.built, tri.id_text[tri.built]);
+        TRACE_END(t, "trigram batch");
+        if (tri.built >= tri.id_count) {
+            tri.ready = 1;
+            pthread_mutex_unlock(&tri_lock);
+            break;
+        }
+        pthread_mutex_unlock(&tri_lock);
+    }
+    return NULL;
+}
+
+// Id bookkeeping
+
+static int tri_reserve_lines(size_t n) {
+    if (n <= tri.line_cap) return 0;
+    size_t cap = tri.line_cap ? tri.line_cap : 1024;
+    while (cap < n) cap *= 2;
+    uint32_t *id_of_line = realloc(tri.id_of_line, cap * sizeof(uint32_t));
+    if (!id_of_line) return -1;
+    tri.id_of_line = id_of_line;
+    tri.line_cap = cap;
+    return 0;
+}
+
+// New id for text, lock held
+static long tri_new_id(char *text) {
+    if (tri.id_count == tri.id_cap) {
+        size_t cap = tri.id_cap ? tri.id_cap * 2 : 1024;
+        if (cap > UINT32_MAX) return -1;
+        char **id_text = realloc(tri.id_text, cap * sizeof(char *));
+        if (!id_text) return -1;
+        tri.id_text = id_text;
+        size_t *line_of_id = realloc(tri.line_of_id, cap * sizeof(size_t));
+        if (!line_of_id) return -1;
+        tri.line_of_id = line_of_id;
+        tri.id_cap = cap;
+    }
+    tri.id_text[tri.id_count] = text;
+    return (long)tri.id_count++;
+}
+
+// Lifetime
+
+static int tri_start_builder(void) {
+    tri.stop = 0;
+    if (pthread_create(&tri.builder, NULL, tri_build, NULL) != 0) return -1;
+    tri.running = 1;
+    return 0;
+}
+
+static void tri_stop_builder(void) {
+    if (!tri.running) return;
+    pthread_mutex_lock(&tri_lock);
+    tri.stop = 1;
+    pthread_mutex_unlock(&tri_lock);
+    pthread_join(tri.builder, NULL);
+    tri.running = 0;
+}
+
+int tri_enable(void) {
+    if (tri.enabled) return 0;
+    if (tri_reserve_lines(line_count) < 0) return -1;
+    for (size_t i = 0; i < line_count; ++i) {
+        long id = tri_new_id(lines[i]);
+        if (id < 0) {
+            tri_disable();
+            return -1;
+        }
+        tri.id_of_line[i] = (uint32_t)id;
+        tri.line_of_id[id] = i;
+    }
+    tri.enabled = 1;
+    if (tri_start_builder() < 0) {
+        tri_disable();
+        return -1;
+    }
+    return 0;
+}
+
+void tri_disable(void) {
+    tri_stop_builder();
+    for (size_t i = 0; i < tri.slot_count; ++i) free(tri.slots[i].ids);
+    free(tri.slots);
+    free(tri.id_text);
+    free(tri.id_of_line);
+    free(tri.line_of_id);
+    tri.slots = NULL;
+    tri.slot_count = tri.slot_used = 0;
+    tri.id_text = NULL;
+    tri.id_of_line = NULL;
+    tri.line_of_id = NULL;
+    tri.id_count = tri.id_cap = tri.line_cap = tri.dead = tri.built = 0;
+    tri.enabled = tri.ready = tri.failed = 0;
+}
+
+int tri_enabled(void) {
+    return tri.enabled;
+}
+
+int tri_ready(void) {
+    pthread_mutex_lock(&tri_lock);
+    int ready = tri.ready;
+    pthread_mutex_unlock(&tri_lock);
+    return ready;
+}
+
+// Per-buffer state
+
+// Hand over the index of the buffer leaving the view (NULL if it has
+// none) and start out without one; an unfinished build is paused
+void *tri_park(void) {
+    if (!tri.enabled) return NULL;
+    tri_stop_builder();
+    struct tri_state *saved = malloc(sizeof(*saved));
+    if (!saved) {
+        tri_disable();
+        return NULL;
+    }
+    *saved = tri;
+    memset(&tri, 0, sizeof(tri));
+    return saved;
+}
+
+// Take back a parked index and resume its build where it stopped
+void tri_unpark(void *state) {
+    tri_disable();
+    if (!state) return;
+    tri = *(struct tri_state *)state;
+    free(state);
+    if (!tri.ready && tri_start_builder() < 0) tri_disable();
+}
+
+// Edit hooks
+
+void tri_line_inserted(size_t index) {
+    if (!tri.enabled) return;
+    pthread_mutex_lock(&tri_lock);
+    long id = tri_reserve_lines(line_count) < 0 ? -1 : tri_new_id(lines[index]);
+    if (id >= 0 && tri.ready) tri_index_line((uint32_t)id, lines[index]);
+    pthread_mutex_unlock(&tri_lock);
+    if (id < 0) {
+        tri_disable();      // out of memory: searches fall back to scanning
+        return;
+    }
+
+    for (size_t i = line_count - 1; i > index; --i) {
+        tri.id_of_line[i] = tri.id_of_line[i - 1];
+        tri.line_of_id[tri.id_of_line[i]] = i;
+    }
+    tri.id_of_line[index] = (uint32_t)id;
+    tri.line_of_id[id] = index;
+}
+
+void tri_line_deleting(size_t index) {
+    if (!tri.enabled) return;
+    pthread_mutex_lock(&tri_lock);
+    tri.id_text[tri.id_of_line[index]] = NULL;
+    if (++tri.dead > 1024 && tri.dead * 2 > tri.id_count && tri.ready)
+        tri_compact();
+    pthread_mutex_unlock(&tri_lock);
+
+    for (size_t i = index; i + 1 < line_count; ++i) {
+        tri.id_of_line[i] = tri.id_of_line[i + 1];
+        tri.line_of_id[tri.id_of_line[i]] = i;
+    }
+}
+
+// A batch from apply_edits: forget the lines it deletes before they are
+// freed, then give its inserts ids and move the lines after them
+void tri_edits_deleting(const zx_edit *edits, size_t n) {
+    if (!tri.enabled) return;
+    pthread_mutex_lock(&tri_lock);
+    for (size_t k = 0; k < n; ++k) {
+        if (edits[k].op != ZX_DELETE) continue;
+        tri.id_text[tri.id_of_line[edits[k].index]] = NULL;
+        tri.dead++;
+    }
+    if (tri.dead > 1024 && tri.dead * 2 > tri.id_count && tri.ready) tri_compact();
+    pthread_mutex_unlock(&tri_lock);
+}
+
+void tri_edits_applied(const zx_edit *edits, size_t n) {
+    if (!tri.enabled || !n) return;
+    uint32_t *out = malloc((line_count ? line_count : 1) * sizeof(uint32_t));
+    int failed = !out || tri_reserve_lines(line_count) < 0;
+
+    pthread_mutex_lock(&tri_lock);
+    size_t from = 0, to = 0;
+    for (size_t k = 0; !failed && k < n; ++k) {
+        while (from < edits[k].index) out[to++] = tri.id_of_line[from++];
+        if (edits[k].op == ZX_DELETE) {
+            from++;
+            continue;
+        }
+        long id = tri_new_id(lines[to]);
+        if (id < 0) {
+            failed = 1;
+            break;
+        }
+        if (tri.ready) tri_index_line((uint32_t)id, lines[to]);
+        out[to++] = (uint32_t)id;
+    }
+    pthread_mutex_unlock(&tri_lock);
+    if (failed) {
+        free(out);
+        tri_disable();      // out of memory: searches fall back to scanning
+        return;
+    }
+
+    while (to < line_count) out[to++] = tri.id_of_line[from++];
+    memcpy(tri.id_of_line, out, line_count * sizeof(uint32_t));
+    free(out);
+    for (size_t i = edits[0].index; i < line_count; ++i) tri.line_of_id[tri.id_of_line[i]] = i;
+}
+
+// Queries
+
+static int cmp_size(const void *a, const void *b) {
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+long tri_candidates(const char *lit, size_t len, size_t **out) {
+    if (len < 3 || !tri.enabled) return -1;
+    pthread_mutex_lock(&tri_lock);
+    if (!tri.ready || tri.failed) {
+        pthread_mutex_unlock(&tri_lock);
+        return -1;
+    }
+
+    // Start from the shortest posting list, then intersect the rest
+    const unsigned char *s = (const unsigned char *)lit;
+    struct posting *best = NULL;
+    for (size_t i = 0; i + 2 < len; ++i) {
+        uint32_t key = (uint32_t)s[i] << 16 | (uint32_t)s[i + 1] << 8 | s[i + 2];
+        struct posting *p = tri_find(key);
+        if (!p || !p->n) {
+            pthread_mutex_unlock(&tri_lock);
+            *out = NULL;
+            return 0;
+        }
+        if (!best || p->n < best->n) best = p;
+    }
+
+    uint32_t *ids = malloc(best->n * sizeof(uint32_t));
+    if (!ids) {
+        pthread_mutex_unlock(&tri_lock);
+        return -1;
+    }
+    size_t n = 0;
+    for (uint32_t j = 0; j < best->n; ++j)
+        if (tri.id_text[best->ids[j]]) ids[n++] = best->ids[j];
+
+    for (size_t i = 0; i + 2 < len && n; ++i) {
+        uint32_t key = (uint32_t)s[i] << 16 | (uint32_t)s[i + 1] << 8 | s[i + 2];
+        struct posting *p = tri_find(key);
+        if (p == best) continue;
+        size_t k = 0;
+        for (size_t a = 0, b = 0; a < n && b < p->n;) {
+            if (ids[a] < p->ids[b]) a++;
+            else if (ids[a] > p->ids[b]) b++;
+            else { ids[k++] = ids[a]; a++; b++; }
+        }
+        n = k;
+    }
+    pthread_mutex_unlock(&tri_lock);
+
+    // Ids to current line indices, in buffer order
+    size_t *res = malloc((n ? n : 1) * sizeof(size_t));
+    if (!res) {
+        free(ids);
+        return -1;
+    }
+    for (size_t i = 0; i < n; ++i) res[i] = tri.line_of_id[ids[i]];
+    free(ids);
+    qsort(res, n, sizeof(size_t), cmp_size);
+    *out = res;
+    return (long)n;
+}
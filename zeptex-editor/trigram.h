@@ -0,0 +1,44 @@
+/* trigram.h - optional trigram posting-list index over the buffer
+   Built on a background thread after load_file and kept current by
+   insert_line/delete_line.  Searches ask it for the (sorted) lines that
+   contain every trigram of a literal and only verify those lines.
+*/
+#ifndef TRIGRAM_H
+#define TRIGRAM_H
+
+#include <stddef.h>   /* for size_t */
+
+#include "zeptex.h"   /* zx_edit */
+
+/*--------------------------------------------------------------------
+  Lifetime
+ --------------------------------------------------------------------*/
+int  tri_enable(void);      /* index the current buffer in background */
+void tri_disable(void);     /* stop the builder and drop the index    */
+int  tri_ready(void);       /* 1 once the background build finished   */
+int  tri_enabled(void);
+
+/*--------------------------------------------------------------------
+  Per-buffer state (buffer.c): a hidden buffer keeps its index, and an
+  unfinished build is paused until the buffer is shown again
+ --------------------------------------------------------------------*/
+void *tri_park(void);
+void tri_unpark(void *state);
+
+/*--------------------------------------------------------------------
+  Edit hooks (0-based indices, called by the buffer primitives)
+ --------------------------------------------------------------------*/
+void tri_line_inserted(size_t index);   /* after lines[index] is set  */
+void tri_line_deleting(size_t index);   /* before lines[index] is freed */
+void tri_edits_deleting(const zx_edit *edits, size_t n);   /* apply_edits: first */
+void tri_edits_applied(const zx_edit *edits, size_t n);    /* then, once merged  */
+
+/*--------------------------------------------------------------------
+  Queries
+  Returns the number of candidate lines stored in *out (caller frees),
+  or -1 when the index cannot narrow the search (not built yet, or the
+  literal is shorter than three bytes).
+ --------------------------------------------------------------------*/
+long tri_candidates(const char *lit, size_t len, size_t **out);
+
+#endif /* TRIGRAM_H */
@@ -0,0 +1,62 @@
+#include "watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Open the watches, 0 on success
+int watch_open(struct file_watch *w, const char *filename, uint32_t mask) {
+    w->path = realpath(filename, NULL);
+    w->ino = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    w->file_wd = w->dir_wd = -1;
+    w->mask = mask | IN_MOVE_SELF | IN_DELETE_SELF;
+    if (!w->path || w->ino < 0 || watch_rearm(w) < 0) {
+        watch_close(w);
+        return -1;
+    }
+
+    char *slash = strrchr(w->path, '/');
+    *slash = '\0';
+    w->dir_wd = inotify_add_watch(w->ino, slash == w->path ? "/" : w->path,
+                                  IN_CREATE | IN_MOVED_TO);
+    *slash = '/';
+    return 0;
+}
+
+// Move the file watch to whatever inode the path names now
+int watch_rearm(struct file_watch *w) {
+    if (w->file_wd >= 0) inotify_rm_watch(w->ino, w->file_wd);
+    w->file_wd = inotify_add_watch(w->ino, w->path, w->mask);
+    return w->file_wd < 0 ? -1 : 0;
+}
+
+// Drain queued events and summarise them as WATCH_* bits
+int watch_poll(struct file_watch *w) {
+    if (w->ino < 0) return 0;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = strrchr(w->path, '/') + 1;
+    int flags = 0;
+    ssize_t n;
+    while ((n = read(w->ino, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->wd == w->file_wd) {
+                flags |= WATCH_CHANGED;
+                if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) flags |= WATCH_REPLACED;
+            } else if (ev->wd == w->dir_wd && ev->len && strcmp(ev->name, name) == 0) {
+                flags |= WATCH_REPLACED;
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return flags;
+}
+
+void watch_close(struct file_watch *w) {
+    if (w->ino >= 0) close(w->ino);     // drops every watch with it
+    free(w->path);
+    w->path = NULL;
+    w->ino = w->file_wd = w->dir_wd = -1;
+}
@@ -0,0 +1,27 @@
+/* watch.h - inotify watch on one file and on its directory
+   The directory watch notices the file being replaced (rename over it,
+   delete and recreate), which a watch on the old inode cannot see.
+   Shared by follow mode and by reload-on-change.
+*/
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdint.h>
+
+struct file_watch {
+    char *path;         /* absolute path of the watched file          */
+    int ino;            /* inotify instance, -1 when closed           */
+    int file_wd;        /* watch on the current inode, -1 if missing  */
+    int dir_wd;         /* watch on the parent directory              */
+    uint32_t mask;      /* file events wanted by the caller           */
+};
+
+/* watch_poll() result bits */
+enum { WATCH_CHANGED = 1, WATCH_REPLACED = 2 };
+
+int  watch_open(struct file_watch *w, const char *filename, uint32_t mask);
+int  watch_rearm(struct file_watch *w);     /* after WATCH_REPLACED   */
+int  watch_poll(struct file_watch *w);      /* drains pending events  */
+void watch_close(struct file_watch *w);
+
+#endif /* WATCH_H */
@@ -0,0 +1,179 @@
+#include "zeptex.h"
+#include "edits.h"
+#include "stream.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct zx_line {
+    char *text;
+    size_t len;
+};
+
+struct zx_buffer {
+    struct zx_line *lines;
+    size_t count, cap;
+};
+
+// Helpers
+
+static int zx_reserve(zx_buffer *b, size_t n) {
+    if (n <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : 1024;
+    while (cap < n) cap *= 2;
+    struct zx_line *grown = realloc(b->lines, cap * sizeof(*grown));
+    if (!grown) return -1;
+    b->lines = grown;
+    b->cap = cap;
+    return 0;
+}
+
+static void zx_clear(zx_buffer *b) {
+    for (size_t i = 0; i < b->count; ++i) free(b->lines[i].text);
+    b->count = 0;
+}
+
+// Lifetime
+
+zx_buffer *zx_buffer_new(void) {
+    return calloc(1, sizeof(zx_buffer));
+}
+
+void zx_buffer_free(zx_buffer *b) {
+    if (!b) return;
+    zx_clear(b);
+    free(b->lines);
+    free(b);
+}
+
+// Files
+
+int zx_load(zx_buffer *b, const char *path) {
+    struct stream *s = stream_open(path, STREAM_READ);
+    if (!s) return -1;
+    zx_clear(b);
+
+    char *text;
+    size_t len;
+    int err = 0;
+    while ((text = stream_getline(s, &len))) {
+        if (zx_reserve(b, b->count + 1) < 0) {
+            free(text);
+            err = ENOMEM;
+            break;
+        }
+        b->lines[b->count++] = (struct zx_line){ text, len };
+    }
+    if (!err) err = s->rerr;
+    stream_close(s);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int zx_save(const zx_buffer *b, const char *path) {
+    struct stream *s = stream_open(path, STREAM_WRITE);
+    if (!s) return -1;
+    for (size_t i = 0; i < b->count; ++i) {
+        stream_write(s, b->lines[i].text, b->lines[i].len);
+        stream_write(s, "\n", 1);
+    }
+    return stream_close(s);
+}
+
+// Editing
+
+int zx_insert(zx_buffer *b, size_t index, const char *text, size_t len) {
+    if (index > b->count) {
+        errno = ERANGE;
+        return -1;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy || zx_reserve(b, b->count + 1) < 0) {
+        free(copy);
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    memmove(b->lines + index + 1, b->lines + index, (b->count - index) * sizeof(*b->lines));
+    b->lines[index] = (struct zx_line){ copy, len };
+    b->count++;
+    return 0;
+}
+
+int zx_delete(zx_buffer *b, size_t index) {
+    if (index >= b->count) {
+        errno = ERANGE;
+        return -1;
+    }
+    free(b->lines[index].text);
+    memmove(b->lines + index, b->lines + index + 1, (b->count - index - 1) * sizeof(*b->lines));
+    b->count--;
+    return 0;
+}
+
+// One merge of the old line array with the sorted edits into a new one
+int zx_apply(zx_buffer *b, const zx_edit *edits, size_t n) {
+    size_t inserts, deletes;
+    if (edits_check(edits, n, b->count, &inserts, &deletes) < 0) return -1;
+
+    // Allocate everything first so a failure leaves the buffer as it was
+    size_t count = b->count - deletes + inserts;
+    size_t cap = count > b->cap ? count : b->cap;
+    struct zx_line *out = malloc((cap ? cap : 1) * sizeof(*out));
+    char **copies = out ? edits_copy(edits, n, inserts) : NULL;
+    if (!copies) {
+        free(out);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t from = 0, to = 0, c = 0;
+    for (size_t k = 0; k < n; ++k) {
+        const zx_edit *e = &edits[k];
+        if (e->index > from) {      // not just after deleting line index
+            memcpy(out + to, b->lines + from, (e->index - from) * sizeof(*out));
+            to += e->index - from;
+            from = e->index;
+        }
+        if (e->op == ZX_INSERT) {
+            out[to++] = (struct zx_line){ copies[c++], e->len };
+        } else {
+            free(b->lines[from++].text);
+        }
+    }
+    if (from < b->count)        // an empty buffer may have no array yet
+        memcpy(out + to, b->lines + from, (b->count - from) * sizeof(*out));
+
+    free(copies);
+    free(b->lines);
+    b->lines = out;
+    b->count = count;
+    b->cap = cap;
+    return 0;
+}
+
+// Reading
+
+size_t zx_line_count(const zx_buffer *b) {
+    return b->count;
+}
+
+const char *zx_line(const zx_buffer *b, size_t index, size_t *len) {
+    if (index >= b->count) return NULL;
+    if (len) *len = b->lines[index].len;
+    return b->lines[index].text;
+}
+
+void zx_iter_init(zx_iter *it, const zx_buffer *b, size_t from) {
+    it->b = b;
+    it->next = from;
+}
+
+const char *zx_iter_next(zx_iter *it, size_t *len) {
+    return zx_line(it->b, it->next++, len);
+}
@@ -0,0 +1,67 @@
+/* zeptex.h - the editing engine as a library (libzeptex)
+   Everything lives in a zx_buffer handle, nothing in globals, so any
+   number of buffers can be open at once and different buffers can be
+   used from different threads without locking; one buffer used from
+   several threads needs the caller's lock.  Files are read and written
+   through the same stream backends as the editor (plain, gzip).
+   Line indices are 0-based.  Calls that can fail return -1 and set
+   errno.
+*/
+#ifndef ZEPTEX_H
+#define ZEPTEX_H
+
+#include <stddef.h>   /* for size_t */
+
+typedef struct zx_buffer zx_buffer;
+
+/*--------------------------------------------------------------------
+  Lifetime
+ --------------------------------------------------------------------*/
+zx_buffer *zx_buffer_new(void);             /* empty, NULL if out of memory */
+void zx_buffer_free(zx_buffer *b);
+
+/*--------------------------------------------------------------------
+  Files
+ --------------------------------------------------------------------*/
+int zx_load(zx_buffer *b, const char *path);        /* replaces the lines */
+int zx_save(const zx_buffer *b, const char *path);  /* .gz is compressed  */
+
+/*--------------------------------------------------------------------
+  Editing
+ --------------------------------------------------------------------*/
+int zx_insert(zx_buffer *b, size_t index, const char *text, size_t len);
+int zx_delete(zx_buffer *b, size_t index);
+
+/* Many edits in one pass over the buffer, O(lines + edits) however many
+   there are.  Indices refer to the buffer before the batch and must not
+   decrease; inserts at index i go before original line i, in the order
+   given, and each line is deleted at most once (delete i plus insert i
+   replaces it).  On error nothing is changed. */
+enum { ZX_INSERT, ZX_DELETE };
+
+typedef struct {
+    int op;                 /* ZX_INSERT or ZX_DELETE */
+    size_t index;
+    const char *text;       /* ZX_INSERT only */
+    size_t len;
+} zx_edit;
+
+int zx_apply(zx_buffer *b, const zx_edit *edits, size_t n);
+
+/*--------------------------------------------------------------------
+  Reading
+  Returned text is NUL-terminated and stays valid until that line is
+  deleted or the buffer is loaded again or freed.
+ --------------------------------------------------------------------*/
+size_t zx_line_count(const zx_buffer *b);
+const char *zx_line(const zx_buffer *b, size_t index, size_t *len);
+
+typedef struct {
+    const zx_buffer *b;
+    size_t next;
+} zx_iter;
+
+void zx_iter_init(zx_iter *it, const zx_buffer *b, size_t from);
+const char *zx_iter_next(zx_iter *it, size_t *len);    /* NULL at the end */
+
+#endif /* ZEPTEX_H */